@@ -4,12 +4,25 @@
  * * The ESP32 acts ONLY as a server for two functions:
  * * 1. Sensor Polling Server (Port 8082): Listens for Python to connect and request sensor data.
  * * 2. Image Reception Server (Port 8080): Listens for Python to connect and stream the image.
+ * *    Images arrive as framed packets (see FrameHeader) and are acknowledged with "OK <id>".
+ * *    One connection may carry many frames back to back (keep-alive session).
+ * * 3. Multicast Frame Receiver (UDP 239.0.80.90:8090): the same frame for many displays at once.
+ * * 4. Animation streams on the image session: frames presented on a fixed cadence, late ones dropped.
+ * * 5. Overlay layers: live sensor text composited over the last image on the device, no resend.
+ * * 6. Frame cache on flash (LittleFS): a recurring image is asked for by content key and redrawn locally.
+ * * 7. Offline slideshow: with no live image for a while, the cached frames are played from flash.
  * * The Python script (laptop) now initiates all connections, bypassing corporate firewall restrictions.
  */
 
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <TFT_eSPI.h> 
+#include <TJpg_Decoder.h>
+#include <LittleFS.h>
 #include "driver/temp_sensor.h" 
+#include "rom/crc.h"
+#include "lwip/sockets.h"
+#include "esp_heap_caps.h"
 
 // --------------------------------------------------------
 // --- WIFI & NETWORK CONFIGURATION ---
@@ -27,6 +40,47 @@ const int sensor_request_port = 8082; // ESP32 SERVER: sends sensor data on requ
 WiFiServer imageServer(image_transfer_port); 
 WiFiServer sensorRequestServer(sensor_request_port); 
 
+// Keep-alive image session: frames on one connection are handled back to back
+// between sensor requests. A newer connection replaces the current one.
+#define SESSION_IDLE_TIMEOUT_MS 120000
+WiFiClient imageSession;
+bool sessionOpen = false;
+uint32_t sessionLastActivity = 0;
+uint32_t sessionFrames = 0;
+
+// Animation stream on the image session, started and ended by a STREAM_MAGIC message.
+// Frame k of the stream is due k periods after the first one arrived. A frame that is
+// early waits for its slot; a full frame (raw, RLE, JPEG) that is ready only when the
+// next frame is already due is skipped ("ERR <id> late"). With a back buffer the frame
+// is received and decoded before its slot is checked, and a skipped one still lands in
+// the back buffer; without one the check comes first and the payload is discarded.
+struct StreamState {
+  bool     active;
+  uint32_t periodMicros;
+  uint32_t startMicros;         // due time of the first frame
+  uint32_t received;            // frames seen, drawn or dropped; sets the next due time
+  uint32_t presented;
+  uint32_t dropped;
+  uint32_t firstPresentMicros;
+  uint32_t lastPresentMicros;
+  uint64_t jitterSumMicros;     // sum of |present interval - period|
+  uint32_t maxLateMicros;       // latest start of a frame that was still drawn
+  bool     missingBase;         // no back buffer and the last full frame was skipped: deltas wait for the next
+  bool     undrawn;             // back-buffer rows of skipped frames, presented with the next frame
+  uint16_t undrawnX0, undrawnY0, undrawnX1, undrawnY1;
+};
+StreamState stream;
+
+// Per-frame log lines block for milliseconds once the UART FIFO is full, so they
+// are muted while a stream runs.
+#define FRAME_LOG(...) do { if (!stream.active) Serial.printf(__VA_ARGS__); } while (0)
+
+// Multicast frames: every display in the group receives the same row packets;
+// each one asks the sender (unicast) only for the rows it missed.
+const IPAddress multicast_group(239, 0, 80, 90);
+const int multicast_port = 8090;
+WiFiUDP frameUdp;
+
 
 // --------------------------------------------------------
 // --- TFT & IMAGE CONFIGURATION (Unchanged) ---
@@ -40,7 +94,360 @@ TFT_eSPI tft = TFT_eSPI();
 
 const size_t EXPECTED_IMAGE_SIZE = IMAGE_WIDTH * IMAGE_HEIGHT * 2; 
 const size_t LINE_BYTE_COUNT = IMAGE_WIDTH * 2; 
-uint8_t lineBuf[LINE_BYTE_COUNT]; 
+
+// Ping-pong row buffers: row N+1 is received from the network while row N is
+// still being clocked out by SPI DMA. Must be >= 2 and live in internal RAM
+// (DMA cannot read from PSRAM).
+#define LINE_BUFFER_COUNT 2
+uint16_t lineBufs[LINE_BUFFER_COUNT][IMAGE_WIDTH];
+
+// Palettized frames: indices for one row, expanded through paletteLut into a line buffer.
+uint8_t indexBuf[IMAGE_WIDTH];
+uint16_t paletteLut[256];
+
+// Tear-free updates: frames are decoded into an off-screen copy of the panel and
+// presented in one burst once the payload CRC has passed, so the last good image
+// stays up while the next one arrives and a failed transfer never reaches the
+// panel. The buffer goes in PSRAM when the board has it, else in internal RAM if
+// BACK_BUFFER_INTERNAL_RESERVE bytes would still be left for WiFi and JPEG frames;
+// without room the frames are drawn straight to the panel as before.
+// Frames are decoded in place, so a second buffer, placed the same way, keeps what
+// the panel shows (under the overlays). A failed frame's rectangle is copied back
+// from it, and the back buffer holds the last good image again. Without room for
+// that copy, the failed rows stay behind and are tracked as stale instead.
+#define USE_BACK_BUFFER 1
+#define BACK_BUFFER_INTERNAL_RESERVE (64 * 1024)
+
+struct BackBuffer {
+  uint16_t* pixels;   // IMAGE_WIDTH x IMAGE_HEIGHT, host byte order; NULL when drawing to the panel
+  uint16_t* lastGood; // the presented image, filled by presentBackBuffer(); NULL if there was no room
+  bool      inPsram;
+  // Bounding box of rows in the back buffer that the panel does not show: an
+  // interrupted frame awaiting resume, a multicast frame still arriving, or a failed
+  // frame that could not be rolled back. A delta frame over them would present them,
+  // so it is refused until a full frame has covered them.
+  bool      stale;
+  uint16_t  staleX0, staleY0, staleX1, staleY1;
+};
+BackBuffer back = { NULL, NULL, false, false, 0, 0, 0, 0 };
+
+// Frame cache: whole back-buffer images in LittleFS, one file per content key,
+// least recently used evicted first. Needs a back buffer; without one every
+// query misses. Hit rate, evictions and flash throughput are reported by
+// "GET_STATS" on the sensor port.
+#define USE_FRAME_CACHE 1
+#define CACHE_DIR "/cache"
+#define CACHE_MAX_ENTRIES 8
+#define CACHE_FREE_RESERVE (16 * 1024)  // LittleFS needs spare blocks for its own metadata
+
+struct CacheEntry {
+  uint64_t key;
+  uint32_t lastUsed;  // FrameCache::useClock at the last store or hit; 0 for files found at boot
+};
+
+struct FrameCache {
+  bool       ready;
+  uint8_t    count;
+  uint32_t   useClock;
+  CacheEntry entries[CACHE_MAX_ENTRIES];
+  // Set by a miss: the frame with this id is stored under this key once presented.
+  bool       pending;
+  uint32_t   pendingFrameId;
+  uint64_t   pendingKey;
+  uint32_t   hits, misses, evictions, stores;
+  uint64_t   bytesRead, readMicros;
+  uint64_t   bytesWritten, writeMicros;
+};
+FrameCache frameCache;
+
+// Offline slideshow: after SLIDESHOW_IDLE_MS without a live image (host or AI API
+// down) the SLIDESHOW_FRAMES most recently used cached frames are played in turn,
+// newest first. Slides are streamed from flash to the panel row by row, so the
+// back buffer keeps the last live image; it goes back up as soon as the host
+// sends anything on the image session or the multicast group.
+#define USE_SLIDESHOW 1
+#define SLIDESHOW_IDLE_MS 120000  // four missed polling cycles
+#define SLIDESHOW_PERIOD_MS 15000
+#define SLIDESHOW_FRAMES 5
+
+struct Slideshow {
+  bool     showing;
+  uint32_t lastLiveMillis;     // last message from the host
+  uint32_t lastSlideMillis;
+  uint8_t  position;           // next slide, counted in most-recent-first order
+  uint64_t currentKey;         // the cached frame on the panel while showing
+  uint32_t slides;
+};
+Slideshow slideshow;
+
+// Overlay layers: small 16-bit sprites kept on top of the image. With a back
+// buffer they are composited into every present, their OVERLAY_TRANSPARENT
+// pixels letting the image through, and a changed layer re-presents only its
+// own box from the back buffer. Without one a layer is drawn opaque, again
+// after each frame that overlaps it.
+#define MAX_OVERLAYS 2
+#define OVERLAY_TRANSPARENT TFT_MAGENTA  // sprite colour that shows the image underneath
+
+struct OverlayLayer {
+  TFT_eSprite* sprite;  // w x h; its buffer holds panel (byte-swapped) RGB565
+  uint16_t     x, y, w, h;
+  bool         visible;
+};
+OverlayLayer overlays[MAX_OVERLAYS];
+uint8_t overlayCount = 0;
+
+// The sensor layer: getSensorReading() in the bottom-right corner, redrawn when
+// the text changes. Updates cost one small present and no network traffic.
+#define USE_SENSOR_OVERLAY 1
+#define SENSOR_OVERLAY_W 96
+#define SENSOR_OVERLAY_H 20
+#define SENSOR_OVERLAY_PERIOD_MS 500
+int8_t sensorOverlay = -1;
+String sensorOverlayText;
+uint32_t sensorOverlayChecked = 0;
+
+
+// --------------------------------------------------------
+// --- FRAME PROTOCOL (PORT 8080) ---
+// --------------------------------------------------------
+// Every frame starts with a 32-byte little-endian header followed by
+// payloadLen bytes of pixel data. The payload CRC is standard CRC-32
+// (same as Python's zlib.crc32). A connection whose first 4 bytes are not
+// FRAME_MAGIC is treated as a legacy headerless 320x170 RGB565 frame.
+// Must match FRAME_HEADER_FORMAT in sensor_ai_display_loop.py.
+#define FRAME_MAGIC            "IMGF"
+#define FRAME_PROTOCOL_VERSION 1
+
+#define PIXFMT_RGB565 0  // 2 bytes per pixel, little-endian
+#define PIXFMT_PAL8 1    // uint16 count, count RGB565 entries, then 1 index byte per pixel
+#define PIXFMT_PAL4 2    // as PAL8 with up to 16 entries, 2 pixels per byte (high nibble first)
+
+#define ENC_RAW 0        // h rows of w pixels, top to bottom
+#define ENC_TILES 1      // sequence of TileHeader + tile pixels, all inside x/y/w/h
+#define ENC_RLE 2        // PackBits on 16-bit pixels, runs may cross rows (see drawRleRows)
+#define ENC_JPEG 3       // baseline JPEG exactly w x h pixels, decoded MCU by MCU
+
+// A JPEG payload is held in RAM while it decodes; the decoded pixels are not.
+#define MAX_JPEG_BYTES (48 * 1024)
+
+// Resumable raw frames: after an interrupted transfer the host reconnects and
+// sends RESUME_MAGIC + uint32 frameId; the reply is "RESUME <id> <nextRow>"
+// (-1 if unknown). The host then sends the remaining rows as a raw frame with
+// the same frameId, y = nextRow and FRAME_FLAG_CONTINUATION set.
+#define RESUME_MAGIC            "IMGQ"
+#define FRAME_FLAG_CONTINUATION 0x0001
+
+// Credit flow control for raw RGB565 frames: with FRAME_FLAG_CREDIT set the host
+// sends only the rows it holds credit for. The ESP32 grants CREDIT_INITIAL_ROWS
+// once the header is accepted and tops up CREDIT_BATCH_ROWS at a time as rows
+// go out to the panel, each grant a "CREDIT <id> <rows>" line. The initial grant
+// fits lwIP's default 5744-byte receive window, so the window never closes and
+// the host streams steadily instead of stalling on TCP zero-window probes.
+// (0x0002 is FRAME_FLAG_INTERLACED on the USB link.)
+#define FRAME_FLAG_CREDIT       0x0004
+#define CREDIT_INITIAL_ROWS     8
+#define CREDIT_BATCH_ROWS       4
+#define FRAME_KNOWN_FLAGS       (FRAME_FLAG_CONTINUATION | FRAME_FLAG_CREDIT)
+
+// Low-resolution frames: a non-zero factor in the scale byte means the payload is
+// a raw RGB565 source of ceil(w/f) x ceil(h/f) pixels, which the ESP32 upscales
+// by f = 2 or 4 into the w x h rectangle as its rows arrive: nearest-neighbour,
+// or bilinear with SCALE_BILINEAR. No flags: the source is at most a quarter of
+// the frame, so it is neither resumable nor credit-flowed.
+#define SCALE_FACTOR_MASK 0x07
+#define SCALE_BILINEAR    0x80
+
+// Animation streams: STREAM_MAGIC + uint32 frame period in microseconds starts a
+// stream of ordinary frames on the session; a period of 0 ends it, and the reply is
+// "STREAM presented=.. dropped=.. fps=.. jitter_us=.. max_late_us=..".
+#define STREAM_MAGIC "IMGS"
+
+// Content-addressed frame cache: before a full image the host may send
+// CACHE_MAGIC + uint32 frameId + uint64 key, the key being a hash of the image's
+// content. "HIT <id>" means the image was redrawn from flash and nothing follows;
+// "MISS <id>" means the frame follows as usual with that frameId, and once it has
+// been presented the back buffer is written to flash under the key.
+#define CACHE_MAGIC "IMGH"
+
+struct __attribute__((packed)) CacheQuery {
+  uint32_t frameId;
+  uint64_t key;
+};
+
+struct __attribute__((packed)) FrameHeader {
+  char     magic[4];
+  uint8_t  version;
+  uint8_t  format;      // PIXFMT_*
+  uint8_t  encoding;    // ENC_*
+  uint8_t  scale;       // SCALE_*; 0 = full resolution
+  uint16_t flags;       // FRAME_FLAG_*
+  uint16_t reserved1;   // must be 0
+  uint16_t x;           // destination rectangle on the panel
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+  uint32_t payloadLen;  // bytes following the header
+  uint32_t frameId;     // echoed back in the ack line
+  uint32_t crc32;       // CRC-32 of the payload
+};
+static_assert(sizeof(FrameHeader) == 32, "FrameHeader must be 32 bytes on the wire");
+
+// Delta frames: each changed tile is sent as its position and size followed
+// by w*h pixels, row by row. The host uses 16x16 tiles (smaller at the edges).
+struct __attribute__((packed)) TileHeader {
+  uint16_t x;
+  uint16_t y;
+  uint8_t  w;
+  uint8_t  h;
+};
+#define TILE_MAX_PIXELS IMAGE_WIDTH  // a whole tile must fit in one line buffer
+
+// --------------------------------------------------------
+// --- MULTICAST PROTOCOL (UDP 8090) ---
+// --------------------------------------------------------
+// The host splits a full-width RGB565 frame into MTU-sized packets of whole
+// rows, then sends MCAST_END. A display that is missing rows answers END (or
+// a MCAST_NACK_TIMEOUT_MS silence, at most MCAST_MAX_SILENT_NACKS times in a
+// row) with a unicast NACK listing the missing row ranges; a complete display
+// answers with a one-off ACK.
+// Must match MCAST_HEADER_FORMAT in sensor_ai_display_loop.py.
+#define MCAST_MAGIC          "IMGU"
+#define MCAST_NACK_MAGIC     "IMGN"  // + frameId, uint16 count, count x (firstRow, rowCount)
+#define MCAST_ACK_MAGIC      "IMGA"  // + frameId
+#define MCAST_DATA           0
+#define MCAST_END            1
+#define MCAST_MAX_PACKET     1472    // UDP payload in one 1500-byte Ethernet/WiFi frame
+#define MCAST_MAX_NACK_RANGES 64
+#define MCAST_NACK_TIMEOUT_MS 150
+#define MCAST_MAX_SILENT_NACKS 20    // unanswered NACKs (~3 s) before an incomplete frame is given up
+
+struct __attribute__((packed)) McastHeader {
+  char     magic[4];
+  uint8_t  type;       // MCAST_DATA / MCAST_END
+  uint8_t  reserved;
+  uint16_t firstRow;
+  uint16_t rowCount;   // rows of IMAGE_WIDTH pixels in this packet
+  uint16_t totalRows;  // frame height; the frame always starts at row 0
+  uint32_t frameId;
+};
+static_assert(sizeof(McastHeader) == 16, "McastHeader must be 16 bytes on the wire");
+
+struct McastFrameState {
+  uint32_t frameId;
+  uint16_t totalRows;
+  uint16_t rowsReceived;
+  bool     active;
+  bool     complete;
+  uint32_t startMillis;
+  uint32_t lastPacketMillis;
+  uint32_t lastNackMillis;
+  uint32_t packets;
+  uint32_t duplicates;
+  uint32_t nacksSent;
+  uint8_t  silentNacks;  // NACKs sent since the last packet arrived
+  bool     rowReceived[IMAGE_HEIGHT];
+};
+McastFrameState mcastFrame;
+uint8_t mcastPacket[MCAST_MAX_PACKET] __attribute__((aligned(4)));
+IPAddress mcastSenderIp;       // NACKs and ACKs go back to whoever sent the frame
+uint16_t mcastSenderPort = 0;
+
+// Progress of the last raw RGB565 frame. Rows before nextY are on the panel.
+struct ResumeState {
+  bool     valid;
+  uint32_t frameId;
+  uint16_t x;
+  uint16_t w;
+  uint16_t nextY;  // first row not yet committed to the panel
+  uint16_t endY;   // one past the frame's last row
+  uint16_t startY; // the frame's first row, presented with the rest from the back buffer
+};
+ResumeState resumeState = { false, 0, 0, 0, 0, 0, 0 };
+
+// Receive side of the image session, read from the lwIP socket directly rather
+// than through WiFiClient, which stages every byte in its own buffer before
+// copying it out. Reads of SESSION_DIRECT_MIN bytes or more (pixel rows, tile
+// pixels, JPEG data) are received straight into the caller's buffer (the back
+// buffer, or a DMA line buffer without one), so the only copy left on the way in
+// is lwIP's own out of its packet buffers.
+// Short reads (RLE control bytes, tile headers) would cost a recv() call each, so
+// they are served from a small staging buffer; a long read that starts inside it
+// copies only the staged part and receives the rest directly.
+// WiFiClient must not read from the session while this is in use.
+#define SESSION_STAGE_BYTES 1436   // one TCP segment
+#define SESSION_DIRECT_MIN  256
+#define SESSION_RX_TIMEOUT_MS 1000 // same as Stream::readBytes()
+
+struct SessionRx {
+  int      fd;
+  uint16_t pos;
+  uint16_t fill;
+  uint32_t directBytes;   // received straight into the caller's buffer
+  uint32_t stagedBytes;   // memcpy'd out of stage[]
+  uint8_t  stage[SESSION_STAGE_BYTES];
+
+  void begin(int socketFd) {
+    fd = socketFd;
+    pos = fill = 0;
+    directBytes = stagedBytes = 0;
+    struct timeval tv = { SESSION_RX_TIMEOUT_MS / 1000, (SESSION_RX_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+
+  size_t buffered() const { return fill - pos; }
+
+  // Blocks until n bytes arrived, the peer closed or the timeout expired; returns the count.
+  size_t read(void* dst, size_t n) {
+    uint8_t* out = (uint8_t*)dst;
+    size_t got = min(n, buffered());
+    memcpy(out, stage + pos, got);
+    pos += got;
+    stagedBytes += got;
+    while (got < n) {
+      if (n - got >= SESSION_DIRECT_MIN) {
+        int r = recv(fd, out + got, n - got, 0);
+        if (r <= 0) break;
+        got += r;
+        directBytes += r;
+      } else {
+        // Takes whatever is queued, up to one segment, so the next short reads are free.
+        int r = recv(fd, stage, sizeof(stage), 0);
+        if (r <= 0) break;
+        fill = r;
+        pos = min(n - got, (size_t)r);
+        memcpy(out + got, stage, pos);
+        got += pos;
+        stagedBytes += pos;
+      }
+    }
+    return got;
+  }
+};
+SessionRx sessionRx;
+
+// Reads exactly the payload announced by the header and keeps a running CRC.
+struct PayloadReader {
+  SessionRx*  in;
+  WiFiClient* client;   // for CREDIT grants
+  uint32_t remaining;
+  uint32_t crc;
+  uint8_t  prefix[4];   // bytes consumed while sniffing for FRAME_MAGIC
+  uint8_t  prefixLen;
+
+  bool read(void* dst, size_t n) {
+    if (n > remaining) return false;
+    uint8_t* out = (uint8_t*)dst;
+    size_t got = 0;
+    while (prefixLen > 0 && got < n) {
+      out[got++] = prefix[0];
+      memmove(prefix, prefix + 1, --prefixLen);
+    }
+    if (got < n) got += in->read(out + got, n - got);
+    crc = crc32_le(crc, out, got);
+    remaining -= got;
+    return got == n;
+  }
+};
 
 
 // --------------------------------------------------------
@@ -78,32 +485,1507 @@ void connectToWiFi() {
 }
 
 // --------------------------------------------------------
-// --- IMAGE DRAWING FUNCTION (Unchanged) ---
+// --- FRAME HEADER HANDLING ---
+// --------------------------------------------------------
+// Bytes of palette indices per row for PIXFMT_PAL8 / PIXFMT_PAL4.
+uint32_t indexRowBytes(const FrameHeader& hdr) {
+  return (hdr.format == PIXFMT_PAL4) ? (hdr.w + 1) / 2 : hdr.w;
+}
+
+// Upscale factor of a low-resolution frame: 1, 2 or 4 once the header is valid.
+uint8_t scaleFactor(const FrameHeader& hdr) {
+  uint8_t factor = hdr.scale & SCALE_FACTOR_MASK;
+  return factor ? factor : 1;
+}
+
+// Size of the payload's source image; the header's w x h for full-resolution frames.
+uint16_t sourceWidth(const FrameHeader& hdr) { return (hdr.w + scaleFactor(hdr) - 1) / scaleFactor(hdr); }
+uint16_t sourceHeight(const FrameHeader& hdr) { return (hdr.h + scaleFactor(hdr) - 1) / scaleFactor(hdr); }
+
+// Returns NULL if the header describes a frame we can draw, else the reason.
+// Nothing is sent to the panel until this has passed.
+const char* validateFrameHeader(const FrameHeader& hdr) {
+  if (hdr.version != FRAME_PROTOCOL_VERSION) return "version";
+  if (hdr.reserved1 != 0 || (hdr.flags & ~FRAME_KNOWN_FLAGS) != 0) return "reserved";
+  uint8_t factor = scaleFactor(hdr);
+  if ((hdr.scale & ~(SCALE_FACTOR_MASK | SCALE_BILINEAR)) || (factor != 1 && factor != 2 && factor != 4)) return "scale";
+  if (factor > 1 && (hdr.format != PIXFMT_RGB565 || hdr.encoding != ENC_RAW || hdr.flags)) return "scale";
+  if (hdr.format > PIXFMT_PAL4) return "format";
+  if ((hdr.flags & (FRAME_FLAG_CONTINUATION | FRAME_FLAG_CREDIT)) && (hdr.format != PIXFMT_RGB565 || hdr.encoding != ENC_RAW)) return "flags";
+  if (hdr.format != PIXFMT_RGB565 && hdr.encoding != ENC_RAW) return "format";
+  if (hdr.w == 0 || hdr.h == 0) return "empty";
+  if ((uint32_t)hdr.x + hdr.w > IMAGE_WIDTH || (uint32_t)hdr.y + hdr.h > IMAGE_HEIGHT) return "geometry";
+  switch (hdr.encoding) {
+    case ENC_RAW:
+      if (hdr.format == PIXFMT_RGB565) {
+        if (hdr.payloadLen != (uint32_t)sourceWidth(hdr) * sourceHeight(hdr) * 2) return "length";
+      } else {
+        // The palette size is only known once the payload starts; bound it here.
+        uint32_t maxEntries = (hdr.format == PIXFMT_PAL8) ? 256 : 16;
+        uint32_t indexBytes = indexRowBytes(hdr) * hdr.h;
+        if (hdr.payloadLen < 2 + 2 + indexBytes || hdr.payloadLen > 2 + maxEntries * 2 + indexBytes) return "length";
+      }
+      break;
+    case ENC_TILES:
+      // Individual tiles are checked against the rectangle as they arrive.
+      if (hdr.payloadLen == 0 || hdr.payloadLen > (uint32_t)hdr.w * hdr.h * (2 + sizeof(TileHeader))) return "length";
+      break;
+    case ENC_RLE:
+      // Worst case is all literals: one control byte per 128 pixels.
+      if (hdr.payloadLen == 0 || hdr.payloadLen > (uint32_t)hdr.w * hdr.h * 2 + ((uint32_t)hdr.w * hdr.h + 127) / 128) return "length";
+      break;
+    case ENC_JPEG:
+      if (hdr.payloadLen == 0 || hdr.payloadLen > MAX_JPEG_BYTES) return "length";
+      break;
+    default:
+      return "encoding";
+  }
+  return NULL;
+}
+
+// Reads the frame header, or synthesises one for a legacy headerless frame.
+// A resume query comes back as a header with magic RESUME_MAGIC and only
+// frameId set. Returns false if the connection closed before 4 bytes arrived.
+bool receiveFrameHeader(WiFiClient& client, SessionRx& rx, FrameHeader& hdr, PayloadReader& reader, bool& legacy) {
+  memset(&hdr, 0, sizeof(hdr));
+  reader.in = &rx;
+  reader.client = &client;
+  reader.crc = 0;
+  reader.prefixLen = 0;
+
+  if (rx.read(hdr.magic, 4) != 4) return false;
+
+  if (memcmp(hdr.magic, RESUME_MAGIC, 4) == 0) {
+    legacy = false;
+    reader.remaining = 0;
+    return rx.read(&hdr.frameId, 4) == 4;
+  }
+  if (memcmp(hdr.magic, STREAM_MAGIC, 4) == 0 || memcmp(hdr.magic, CACHE_MAGIC, 4) == 0) {
+    legacy = false;
+    reader.remaining = 0;
+    return true;  // the caller reads the period or the cache query
+  }
+
+  legacy = memcmp(hdr.magic, FRAME_MAGIC, 4) != 0;
+  if (legacy) {
+    // Those 4 bytes were already pixel data; replay them as the start of row 0.
+    memcpy(reader.prefix, hdr.magic, 4);
+    reader.prefixLen = 4;
+    hdr.version = FRAME_PROTOCOL_VERSION;
+    hdr.format = PIXFMT_RGB565;
+    hdr.encoding = ENC_RAW;
+    hdr.w = IMAGE_WIDTH;
+    hdr.h = IMAGE_HEIGHT;
+    hdr.payloadLen = EXPECTED_IMAGE_SIZE;
+  } else {
+    const size_t rest = sizeof(FrameHeader) - 4;
+    if (rx.read((uint8_t*)&hdr + 4, rest) != rest) return false;
+  }
+  reader.remaining = hdr.payloadLen;
+  return true;
+}
+
+void answerResumeQuery(WiFiClient& client, uint32_t frameId) {
+  if (resumeState.valid && resumeState.frameId == frameId) {
+    Serial.printf("[SERVER 8080] Resume query for frame %lu: continue at row %u.\n",
+                  (unsigned long)frameId, resumeState.nextY);
+    client.printf("RESUME %lu %u\n", (unsigned long)frameId, resumeState.nextY);
+  } else {
+    Serial.printf("[SERVER 8080] Resume query for unknown frame %lu.\n", (unsigned long)frameId);
+    client.printf("RESUME %lu -1\n", (unsigned long)frameId);
+  }
+}
+
+// --------------------------------------------------------
+// --- ANIMATION STREAM PACING ---
+// --------------------------------------------------------
+void startStream(WiFiClient& client, SessionRx& rx) {
+  uint32_t periodMicros = 0;
+  if (rx.read(&periodMicros, 4) != 4) return;
+
+  if (periodMicros == 0) {
+    uint32_t span = stream.lastPresentMicros - stream.firstPresentMicros;
+    float fps = (stream.presented > 1 && span > 0) ? (stream.presented - 1) * 1e6f / span : 0.0f;
+    uint32_t jitter = stream.presented > 1 ? stream.jitterSumMicros / (stream.presented - 1) : 0;
+    client.printf("STREAM presented=%lu dropped=%lu fps=%.2f jitter_us=%lu max_late_us=%lu\n",
+                  (unsigned long)stream.presented, (unsigned long)stream.dropped, fps,
+                  (unsigned long)jitter, (unsigned long)stream.maxLateMicros);
+    Serial.printf("[STREAM] Ended: %lu presented, %lu dropped, %.2f fps (target %.2f), jitter %lu us.\n",
+                  (unsigned long)stream.presented, (unsigned long)stream.dropped, fps,
+                  stream.periodMicros ? 1e6f / stream.periodMicros : 0.0f, (unsigned long)jitter);
+    stream.active = false;
+    return;
+  }
+  memset(&stream, 0, sizeof(stream));
+  stream.active = true;
+  stream.periodMicros = periodMicros;
+  Serial.printf("[STREAM] Started at %.2f fps.\n", 1e6f / periodMicros);
+}
+
+// Waits for the frame's slot. Returns false if the frame is not to be shown: a full
+// frame a whole period late, or, without a back buffer, a delta (tiles) whose base
+// frame was skipped. Other deltas are shown late instead, since the next one
+// patches this one.
+bool waitForStreamSlot(bool delta) {
+  uint32_t now = micros();
+  if (stream.received == 0) stream.startMicros = now;
+  uint32_t due = stream.startMicros + stream.received * stream.periodMicros;
+  stream.received++;
+
+  int32_t early = (int32_t)(due - now);
+  bool skip = delta ? stream.missingBase : early <= -(int32_t)stream.periodMicros;
+  if (!delta) stream.missingBase = skip && !back.pixels;
+  if (skip) {
+    stream.dropped++;
+    return false;
+  }
+  if (early > 0) {
+    delay(early / 1000);
+    delayMicroseconds(early % 1000);
+  } else if ((uint32_t)-early > stream.maxLateMicros) {
+    stream.maxLateMicros = -early;
+  }
+  return true;
+}
+
+// Remembers the rows of a frame decoded into the back buffer but skipped.
+void markUndrawn(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (!stream.undrawn) {
+    stream.undrawn = true;
+    stream.undrawnX0 = x;
+    stream.undrawnY0 = y;
+    stream.undrawnX1 = x + w;
+    stream.undrawnY1 = y + h;
+    return;
+  }
+  stream.undrawnX0 = min(stream.undrawnX0, x);
+  stream.undrawnY0 = min(stream.undrawnY0, y);
+  stream.undrawnX1 = max(stream.undrawnX1, (uint16_t)(x + w));
+  stream.undrawnY1 = max(stream.undrawnY1, (uint16_t)(y + h));
+}
+
+// Widens a rectangle about to be presented over the rows of skipped frames.
+void takeUndrawn(uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h) {
+  if (!stream.undrawn) return;
+  uint16_t x1 = max((uint16_t)(x + w), stream.undrawnX1);
+  uint16_t y1 = max((uint16_t)(y + h), stream.undrawnY1);
+  x = min(x, stream.undrawnX0);
+  y = min(y, stream.undrawnY0);
+  w = x1 - x;
+  h = y1 - y;
+  stream.undrawn = false;
+}
+
+void recordStreamPresent() {
+  uint32_t now = micros();
+  if (stream.presented == 0) {
+    stream.firstPresentMicros = now;
+  } else {
+    int32_t deviation = (int32_t)(now - stream.lastPresentMicros - stream.periodMicros);
+    stream.jitterSumMicros += deviation < 0 ? -deviation : deviation;
+  }
+  stream.lastPresentMicros = now;
+  stream.presented++;
+}
+
+// Reads and discards a frame's payload, keeping the session in sync.
+bool drainPayload(PayloadReader& reader) {
+  while (reader.remaining > 0) {
+    if (!reader.read(lineBufs[0], min((size_t)reader.remaining, sizeof(lineBufs[0])))) return false;
+  }
+  return true;
+}
+
+void sendFrameAck(WiFiClient& client, const FrameHeader& hdr, const char* error) {
+  if (error) {
+    client.printf("ERR %lu %s\n", (unsigned long)hdr.frameId, error);
+  } else {
+    client.printf("OK %lu\n", (unsigned long)hdr.frameId);
+  }
+}
+
+// --------------------------------------------------------
+// --- BACK BUFFER (TEAR-FREE PRESENT) ---
+// --------------------------------------------------------
+void allocateBackBuffer() {
+  back.pixels = (uint16_t*)heap_caps_calloc(1, EXPECTED_IMAGE_SIZE, MALLOC_CAP_SPIRAM);
+  back.inPsram = back.pixels != NULL;
+  if (!back.pixels && heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= EXPECTED_IMAGE_SIZE + BACK_BUFFER_INTERNAL_RESERVE) {
+    back.pixels = (uint16_t*)heap_caps_calloc(1, EXPECTED_IMAGE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (back.pixels) {
+    if (back.inPsram) {
+      back.lastGood = (uint16_t*)heap_caps_calloc(1, EXPECTED_IMAGE_SIZE, MALLOC_CAP_SPIRAM);
+    } else if (heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= EXPECTED_IMAGE_SIZE + BACK_BUFFER_INTERNAL_RESERVE) {
+      back.lastGood = (uint16_t*)heap_caps_calloc(1, EXPECTED_IMAGE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    Serial.printf("[BACK BUFFER] %u bytes in %s, %s; %u bytes of internal RAM left.\n", EXPECTED_IMAGE_SIZE,
+                  back.inPsram ? "PSRAM" : "internal RAM",
+                  back.lastGood ? "failed frames rolled back to the last good image" : "no room for a last-good copy",
+                  heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  } else {
+    Serial.println("[BACK BUFFER] No room for a back buffer. Frames are drawn straight to the panel.");
+  }
+}
+
+void markStale(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (!back.pixels) return;
+  if (!back.stale) {
+    back = { back.pixels, back.lastGood, back.inPsram, true, x, y, (uint16_t)(x + w), (uint16_t)(y + h) };
+    return;
+  }
+  back.staleX0 = min(back.staleX0, x);
+  back.staleY0 = min(back.staleY0, y);
+  back.staleX1 = max(back.staleX1, (uint16_t)(x + w));
+  back.staleY1 = max(back.staleY1, (uint16_t)(y + h));
+}
+
+bool overlapsStale(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  return back.stale && x < back.staleX1 && x + w > back.staleX0 && y < back.staleY1 && y + h > back.staleY0;
+}
+
+void clearStaleInside(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (back.stale && x <= back.staleX0 && y <= back.staleY0 && x + w >= back.staleX1 && y + h >= back.staleY1) {
+    back.stale = false;
+  }
+}
+
+// Undoes a failed frame: its rectangle goes back to the last presented image, or,
+// without a last-good copy, is marked stale until a full frame covers it.
+void discardFailedRows(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (!back.lastGood) {
+    markStale(x, y, w, h);
+    return;
+  }
+  for (uint16_t r = 0; r < h; r++) {
+    size_t offset = (size_t)(y + r) * IMAGE_WIDTH + x;
+    memcpy(back.pixels + offset, back.lastGood + offset, (size_t)w * 2);
+  }
+  clearStaleInside(x, y, w, h);
+}
+
+// Where row y of a frame is decoded: in place in the back buffer, or the line
+// buffer last used LINE_BUFFER_COUNT rows ago, whose transfer the dmaWait()
+// inside pushPixelsDMA() has seen finish.
+uint16_t* rowTarget(const FrameHeader& hdr, int y) {
+  if (back.pixels) return back.pixels + (size_t)(hdr.y + y) * IMAGE_WIDTH + hdr.x;
+  return lineBufs[y % LINE_BUFFER_COUNT];
+}
+
+// Opens the frame's address window on the panel; nothing to do for the back buffer.
+void panelBegin(const FrameHeader& hdr) {
+  if (back.pixels) return;
+  tft.startWrite();
+  tft.setAddrWindow(hdr.x, hdr.y, hdr.w, hdr.h);
+}
+
+// Queues one row decoded by rowTarget(); back-buffer rows are already in place.
+void pushRow(uint16_t* row, uint16_t w) {
+  if (!back.pixels) tft.pushPixelsDMA(row, w);
+}
+
+void panelEnd() {
+  if (back.pixels) return;
+  tft.dmaWait();
+  tft.endWrite();
+}
+
+// Writes a packed w x h block: its own address window on the panel (inside a
+// startWrite()), or copied row by row into the back buffer.
+void pushBlock(uint16_t* pixels, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (!back.pixels) {
+    tft.dmaWait();  // the address window cannot change under a running transfer
+    tft.setAddrWindow(x, y, w, h);
+    tft.pushPixelsDMA(pixels, (uint32_t)w * h);
+    return;
+  }
+  for (uint16_t r = 0; r < h; r++) {
+    memcpy(back.pixels + (size_t)(y + r) * IMAGE_WIDTH + x, pixels + (size_t)r * w, (size_t)w * 2);
+  }
+}
+
+// Copies the opaque pixels of every visible layer over one row of w pixels
+// starting at (x, y). row is in host byte order, the sprites in panel order.
+void compositeOverlays(uint16_t* row, uint16_t x, uint16_t y, uint16_t w) {
+  const uint16_t key = __builtin_bswap16(OVERLAY_TRANSPARENT);
+  for (uint8_t i = 0; i < overlayCount; i++) {
+    const OverlayLayer& layer = overlays[i];
+    if (!layer.visible || y < layer.y || y >= layer.y + layer.h) continue;
+    uint16_t x0 = max(x, layer.x);
+    uint16_t x1 = min((uint16_t)(x + w), (uint16_t)(layer.x + layer.w));
+    const uint16_t* src = (const uint16_t*)layer.sprite->getPointer() + (size_t)(y - layer.y) * layer.w - layer.x;
+    for (uint16_t px = x0; px < x1; px++) {
+      if (src[px] != key) row[px - x] = __builtin_bswap16(src[px]);
+    }
+  }
+}
+
+// Pushes one rectangle of the back buffer to the panel in a single write burst,
+// with the overlay layers composited on top. DMA cannot read PSRAM, so rows
+// bounce through the ping-pong line buffers; the copy of row N+1 overlaps the
+// transfer of row N. Returns the time taken.
+uint32_t presentBackBuffer(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  uint32_t start = micros();
+  tft.startWrite();
+  tft.setAddrWindow(x, y, w, h);
+  for (uint16_t r = 0; r < h; r++) {
+    uint16_t* rowBuf = lineBufs[r % LINE_BUFFER_COUNT];
+    memcpy(rowBuf, back.pixels + (size_t)(y + r) * IMAGE_WIDTH + x, (size_t)w * 2);
+    if (back.lastGood) memcpy(back.lastGood + (size_t)(y + r) * IMAGE_WIDTH + x, rowBuf, (size_t)w * 2);
+    compositeOverlays(rowBuf, x, y + r, w);
+    tft.pushPixelsDMA(rowBuf, w);  // swaps rowBuf in place; the back buffer keeps host order
+  }
+  tft.dmaWait();
+  tft.endWrite();
+
+  clearStaleInside(x, y, w, h);
+  return micros() - start;
+}
+
+// --------------------------------------------------------
+// --- FRAME CACHE (LITTLEFS) ---
+// --------------------------------------------------------
+void cachePath(uint64_t key, char* path) {
+  snprintf(path, 32, CACHE_DIR "/%08lx%08lx.565", (unsigned long)(key >> 32), (unsigned long)key);
+}
+
+int cacheFind(uint64_t key) {
+  for (uint8_t i = 0; i < frameCache.count; i++) {
+    if (frameCache.entries[i].key == key) return i;
+  }
+  return -1;
+}
+
+void cacheForget(int index) {
+  frameCache.entries[index] = frameCache.entries[--frameCache.count];
+}
+
+// Mounts LittleFS (formatting it the first time) and indexes the frames already
+// cached. Files that are not a whole frame, or beyond CACHE_MAX_ENTRIES, are removed.
+void setupFrameCache() {
+  if (!back.pixels) {
+    Serial.println("[CACHE] Disabled: cached frames are presented from the back buffer.");
+    return;
+  }
+  if (!LittleFS.begin(true)) {
+    Serial.println("[CACHE] Disabled: LittleFS could not be mounted.");
+    return;
+  }
+  LittleFS.mkdir(CACHE_DIR);
+  File dir = LittleFS.open(CACHE_DIR);
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    const char* name = strrchr(f.name(), '/');
+    name = name ? name + 1 : f.name();
+    char* end;
+    uint64_t key = strtoull(name, &end, 16);
+    bool keep = f.size() == EXPECTED_IMAGE_SIZE && strcmp(end, ".565") == 0 && frameCache.count < CACHE_MAX_ENTRIES;
+    char path[64];
+    snprintf(path, sizeof(path), CACHE_DIR "/%s", name);
+    f.close();
+    if (keep) {
+      frameCache.entries[frameCache.count++] = { key, 0 };
+    } else {
+      LittleFS.remove(path);
+    }
+  }
+  frameCache.ready = true;
+  Serial.printf("[CACHE] %u frames cached; %u of %u flash bytes free.\n", frameCache.count,
+                (unsigned)(LittleFS.totalBytes() - LittleFS.usedBytes()), (unsigned)LittleFS.totalBytes());
+}
+
+// Reads a cached frame into the back buffer and presents it. Returns false on a miss.
+bool loadCachedFrame(uint64_t key) {
+  int index = frameCache.ready ? cacheFind(key) : -1;
+  if (index < 0) return false;
+
+  char path[32];
+  cachePath(key, path);
+  uint32_t start = micros();
+  File f = LittleFS.open(path, FILE_READ);
+  size_t n = f ? f.read((uint8_t*)back.pixels, EXPECTED_IMAGE_SIZE) : 0;
+  if (f) f.close();
+  uint32_t readMicros = micros() - start;
+  if (n != EXPECTED_IMAGE_SIZE) {
+    // Part of the back buffer now holds the broken file; it must not be presented by a delta.
+    Serial.printf("[CACHE] %s unreadable (%u bytes); dropped.\n", path, (unsigned)n);
+    resumeState.valid = false;
+    discardFailedRows(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+    LittleFS.remove(path);
+    cacheForget(index);
+    return false;
+  }
+
+  resumeState.valid = false;  // the back buffer no longer holds an interrupted frame's rows
+  uint32_t presentMicros = presentBackBuffer(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+  frameCache.entries[index].lastUsed = ++frameCache.useClock;
+  frameCache.hits++;
+  frameCache.bytesRead += n;
+  frameCache.readMicros += readMicros;
+  Serial.printf("[CACHE] Hit %s: read in %lu us (%lu KB/s), presented in %lu us.\n", path,
+                (unsigned long)readMicros, (unsigned long)((uint64_t)n * 1000000 / 1024 / (readMicros ? readMicros : 1)),
+                (unsigned long)presentMicros);
+  return true;
+}
+
+void answerCacheQuery(WiFiClient& client, SessionRx& rx) {
+  CacheQuery query;
+  if (rx.read(&query, sizeof(query)) != sizeof(query)) return;
+  if (loadCachedFrame(query.key)) {
+    client.printf("HIT %lu\n", (unsigned long)query.frameId);
+    return;
+  }
+  frameCache.misses++;
+  frameCache.pending = frameCache.ready;
+  frameCache.pendingFrameId = query.frameId;
+  frameCache.pendingKey = query.key;
+  Serial.printf("[CACHE] Miss for frame %lu.\n", (unsigned long)query.frameId);
+  client.printf("MISS %lu\n", (unsigned long)query.frameId);
+}
+
+void evictOldestFrame() {
+  int oldest = 0;
+  for (uint8_t i = 1; i < frameCache.count; i++) {
+    if (frameCache.entries[i].lastUsed < frameCache.entries[oldest].lastUsed) oldest = i;
+  }
+  char path[32];
+  cachePath(frameCache.entries[oldest].key, path);
+  LittleFS.remove(path);
+  cacheForget(oldest);
+  frameCache.evictions++;
+}
+
+// Writes the presented back buffer under the pending key. Called after the
+// frame's ack, so the host is not kept waiting for the flash write.
+void storeCachedFrame() {
+  frameCache.pending = false;
+  if (back.stale || cacheFind(frameCache.pendingKey) >= 0) return;
+  while (frameCache.count > 0 && (frameCache.count >= CACHE_MAX_ENTRIES ||
+         LittleFS.totalBytes() - LittleFS.usedBytes() < EXPECTED_IMAGE_SIZE + CACHE_FREE_RESERVE)) {
+    evictOldestFrame();
+  }
+
+  char path[32];
+  cachePath(frameCache.pendingKey, path);
+  uint32_t start = micros();
+  File f = LittleFS.open(path, FILE_WRITE);
+  size_t n = f ? f.write((const uint8_t*)back.pixels, EXPECTED_IMAGE_SIZE) : 0;
+  if (f) f.close();
+  uint32_t writeMicros = micros() - start;
+  if (n != EXPECTED_IMAGE_SIZE) {
+    Serial.printf("[CACHE] Could not store %s (%u bytes written).\n", path, (unsigned)n);
+    LittleFS.remove(path);
+    return;
+  }
+  frameCache.entries[frameCache.count++] = { frameCache.pendingKey, ++frameCache.useClock };
+  frameCache.stores++;
+  frameCache.bytesWritten += n;
+  frameCache.writeMicros += writeMicros;
+  Serial.printf("[CACHE] Stored %s in %lu ms (%u of %u entries).\n", path,
+                (unsigned long)(writeMicros / 1000), frameCache.count, CACHE_MAX_ENTRIES);
+}
+
+// Streams a rectangle of a cached frame from flash to the panel through the
+// ping-pong line buffers, one row per read, with the overlays on top. The back
+// buffer is not touched. Returns false if the file could not be read.
+bool presentCachedRect(uint64_t key, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  char path[32];
+  cachePath(key, path);
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return false;
+  const size_t rowBytes = (size_t)w * 2;
+  bool ok = true;
+  uint32_t readMicros = 0;
+  tft.startWrite();
+  tft.setAddrWindow(x, y, w, h);
+  for (uint16_t r = 0; r < h && ok; r++) {
+    uint16_t* rowBuf = lineBufs[r % LINE_BUFFER_COUNT];
+    uint32_t start = micros();
+    // Full-width rows follow each other in the file; narrower ones need a seek each.
+    if (r == 0 || w != IMAGE_WIDTH) ok = f.seek(((uint32_t)(y + r) * IMAGE_WIDTH + x) * 2);
+    ok = ok && f.read((uint8_t*)rowBuf, rowBytes) == rowBytes;
+    readMicros += micros() - start;
+    if (!ok) break;
+    compositeOverlays(rowBuf, x, y + r, w);
+    tft.pushPixelsDMA(rowBuf, w);
+  }
+  tft.dmaWait();
+  tft.endWrite();
+  f.close();
+  if (ok) {
+    frameCache.bytesRead += rowBytes * h;
+    frameCache.readMicros += readMicros;
+  }
+  return ok;
+}
+
+// One line for "GET_STATS" on the sensor port.
+String cacheStatsLine() {
+  uint32_t queries = frameCache.hits + frameCache.misses;
+  char line[200];
+  snprintf(line, sizeof(line),
+           "cache entries=%u hits=%lu misses=%lu hit_rate=%.1f evictions=%lu stores=%lu read_kbps=%.0f write_kbps=%.0f slides=%lu",
+           frameCache.count, (unsigned long)frameCache.hits, (unsigned long)frameCache.misses,
+           queries ? 100.0f * frameCache.hits / queries : 0.0f, (unsigned long)frameCache.evictions,
+           (unsigned long)frameCache.stores,
+           frameCache.readMicros ? frameCache.bytesRead * 1e6 / 1024 / frameCache.readMicros : 0.0,
+           frameCache.writeMicros ? frameCache.bytesWritten * 1e6 / 1024 / frameCache.writeMicros : 0.0,
+           (unsigned long)slideshow.slides);
+  return String(line);
+}
+
+// --------------------------------------------------------
+// --- OVERLAY LAYERS (DEVICE-SIDE COMPOSITING) ---
+// --------------------------------------------------------
+// Returns the new layer's index, or -1 if there is no slot or no memory for its sprite.
+int8_t addOverlay(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (overlayCount >= MAX_OVERLAYS) return -1;
+  TFT_eSprite* sprite = new TFT_eSprite(&tft);
+  sprite->setColorDepth(16);
+  if (!sprite->createSprite(w, h)) {
+    delete sprite;
+    return -1;
+  }
+  sprite->fillSprite(OVERLAY_TRANSPARENT);
+  overlays[overlayCount] = { sprite, x, y, w, h, false };
+  return overlayCount++;
+}
+
+// Shows a layer whose sprite has changed: its box re-composited from the back
+// buffer, or the sprite pushed as is. Returns the time taken.
+uint32_t refreshOverlay(const OverlayLayer& layer) {
+  uint32_t start = micros();
+  if (slideshow.showing) {
+    presentCachedRect(slideshow.currentKey, layer.x, layer.y, layer.w, layer.h);
+  } else if (back.pixels) {
+    presentBackBuffer(layer.x, layer.y, layer.w, layer.h);
+  } else {
+    layer.sprite->pushSprite(layer.x, layer.y);
+  }
+  return micros() - start;
+}
+
+// Panel mode only: a frame drawn over a layer hides it, so the layer goes back on top.
+void restoreOverlays(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  if (back.pixels) return;  // presentBackBuffer() composites them
+  for (uint8_t i = 0; i < overlayCount; i++) {
+    const OverlayLayer& layer = overlays[i];
+    if (layer.visible && x < layer.x + layer.w && x + w > layer.x && y < layer.y + layer.h && y + h > layer.y) {
+      layer.sprite->pushSprite(layer.x, layer.y);
+    }
+  }
+}
+
+void setupSensorOverlay() {
+  sensorOverlay = addOverlay(IMAGE_WIDTH - SENSOR_OVERLAY_W - 4, IMAGE_HEIGHT - SENSOR_OVERLAY_H - 4,
+                             SENSOR_OVERLAY_W, SENSOR_OVERLAY_H);
+  if (sensorOverlay < 0) {
+    Serial.println("[OVERLAY] No memory for the sensor layer.");
+    return;
+  }
+  TFT_eSprite& sprite = *overlays[sensorOverlay].sprite;
+  sprite.setTextDatum(MR_DATUM);
+  sprite.setTextSize(2);
+  overlays[sensorOverlay].visible = true;
+  Serial.printf("[OVERLAY] Sensor layer %ux%u, %s.\n", SENSOR_OVERLAY_W, SENSOR_OVERLAY_H,
+                back.pixels ? "composited over the back buffer" : "opaque (no back buffer)");
+}
+
+// Redraws the sensor layer when the reading's text changes.
+void updateSensorOverlay() {
+  if (sensorOverlay < 0 || millis() - sensorOverlayChecked < SENSOR_OVERLAY_PERIOD_MS) return;
+  sensorOverlayChecked = millis();
+  String text = getSensorReading().substring(5);  // "temp=23.45C" -> "23.45C"
+  if (text == sensorOverlayText) return;
+  sensorOverlayText = text;
+
+  const OverlayLayer& layer = overlays[sensorOverlay];
+  TFT_eSprite& sprite = *layer.sprite;
+  sprite.fillSprite(back.pixels ? OVERLAY_TRANSPARENT : TFT_BLACK);
+  sprite.setTextColor(TFT_BLACK);  // one-pixel shadow keeps the text readable on light images
+  sprite.drawString(text, layer.w - 1, layer.h / 2 + 1);
+  sprite.setTextColor(TFT_WHITE);
+  sprite.drawString(text, layer.w - 2, layer.h / 2);
+
+  // Rows of a failed or unfinished frame may sit under the layer in the back
+  // buffer; the present that replaces them will composite the new text.
+  if (!slideshow.showing && overlapsStale(layer.x, layer.y, layer.w, layer.h)) return;
+  uint32_t presentMicros = refreshOverlay(layer);
+  FRAME_LOG("[OVERLAY] %s drawn over %ux%u at (%u,%u) in %lu us.\n", text.c_str(),
+            layer.w, layer.h, layer.x, layer.y, (unsigned long)presentMicros);
+}
+
+// --------------------------------------------------------
+// --- OFFLINE SLIDESHOW ---
+// --------------------------------------------------------
+// Called for every message from the host. Ends a slideshow by putting the last
+// live image back up, unless a failed frame has left rows in the back buffer;
+// then the slide stays until the next full frame replaces it.
+void noteHostActivity() {
+  slideshow.lastLiveMillis = millis();
+  if (!slideshow.showing) return;
+  slideshow.showing = false;
+  Serial.printf("[SLIDESHOW] Host is back after %lu slides; live frames resume.\n", (unsigned long)slideshow.slides);
+  if (back.pixels && !back.stale) presentBackBuffer(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+}
+
+// Shows the next slide once the host has been quiet for SLIDESHOW_IDLE_MS.
+void serviceSlideshow() {
+  uint32_t now = millis();
+  if (!frameCache.ready || frameCache.count == 0 || now - slideshow.lastLiveMillis < SLIDESHOW_IDLE_MS) return;
+  if (slideshow.showing && now - slideshow.lastSlideMillis < SLIDESHOW_PERIOD_MS) return;
+
+  // Cache entries, most recently used first.
+  uint8_t order[CACHE_MAX_ENTRIES];
+  for (uint8_t i = 0; i < frameCache.count; i++) {
+    uint8_t j = i;
+    for (; j > 0 && frameCache.entries[order[j - 1]].lastUsed < frameCache.entries[i].lastUsed; j--) order[j] = order[j - 1];
+    order[j] = i;
+  }
+  uint8_t playlist = min(frameCache.count, (uint8_t)SLIDESHOW_FRAMES);
+  uint64_t key = frameCache.entries[order[slideshow.position % playlist]].key;
+  slideshow.position = (slideshow.position + 1) % playlist;
+  slideshow.lastSlideMillis = now;
+  if (slideshow.showing && key == slideshow.currentKey) return;  // a one-frame playlist
+
+  if (!slideshow.showing) {
+    Serial.printf("[SLIDESHOW] No live image for %lu s; playing %u cached frames.\n",
+                  (unsigned long)((now - slideshow.lastLiveMillis) / 1000), playlist);
+  }
+  uint32_t start = micros();
+  if (!presentCachedRect(key, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT)) {
+    char path[32];
+    cachePath(key, path);
+    Serial.printf("[CACHE] %s unreadable; dropped.\n", path);
+    LittleFS.remove(path);
+    cacheForget(cacheFind(key));
+    return;
+  }
+  slideshow.showing = true;
+  slideshow.currentKey = key;
+  slideshow.slides++;
+  Serial.printf("[SLIDESHOW] Slide %lu (%016llx) streamed from flash in %lu ms.\n", (unsigned long)slideshow.slides,
+                (unsigned long long)key, (unsigned long)((micros() - start) / 1000));
+}
+
+// --------------------------------------------------------
+// --- IMAGE DRAWING FUNCTION (DMA PIPELINED) ---
 // --------------------------------------------------------
-void drawImageFromClient(WiFiClient client) {
-  Serial.println("\n[SERVER 8080] Receiving image data from Python...");
-  tft.setAddrWindow(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+// Streams hdr.h rows of hdr.w pixels into the header's rectangle.
+// Returns NULL on success, else the reason the frame was abandoned.
+const char* drawRawRows(PayloadReader& reader, const FrameHeader& hdr) {
+  const size_t rowBytes = (size_t)hdr.w * 2;
+
+  uint32_t frameStart = micros();
+  uint32_t netMicros = 0;      // time blocked in reader.read()
+  uint32_t spiWaitMicros = 0;  // time blocked waiting for the previous DMA transfer
+
+  if (!(hdr.flags & FRAME_FLAG_CONTINUATION)) {
+    resumeState = { true, hdr.frameId, hdr.x, hdr.w, hdr.y, (uint16_t)(hdr.y + hdr.h), hdr.y };
+  }
+
+  // Rows the host may send; with credit flow control, time in reader.read() is time
+  // spent starved of rows that were already granted.
+  const bool credit = hdr.flags & FRAME_FLAG_CREDIT;
+  uint16_t granted = hdr.h;
+  uint16_t grants = 0;
+  if (credit) {
+    granted = min((uint16_t)CREDIT_INITIAL_ROWS, hdr.h);
+    reader.client->printf("CREDIT %lu %u\n", (unsigned long)hdr.frameId, granted);
+    grants++;
+  }
+
+  panelBegin(hdr);
 
   size_t bytesReadTotal = 0;
   
-  for (int y = 0; y < IMAGE_HEIGHT; y++) {
-    size_t bytesRead = client.readBytes((char*)lineBuf, LINE_BYTE_COUNT);
+  for (int y = 0; y < hdr.h; y++) {
+    uint16_t* rowBuf = rowTarget(hdr, y);
+
+    uint32_t t0 = micros();
+    bool ok = reader.read(rowBuf, rowBytes);
+    uint32_t t1 = micros();
+    netMicros += t1 - t0;
     
-    if (bytesRead != LINE_BYTE_COUNT) {
-      Serial.printf("FATAL ERROR: Incomplete read at row %d. Expected %u bytes, got %u. Aborting.\n", y, LINE_BYTE_COUNT, bytesRead);
+    if (!ok) {
+      panelEnd();
+      Serial.printf("FATAL ERROR: Incomplete read at row %d. Expected %u bytes per row. Aborting.\n", hdr.y + y, rowBytes);
+      return "short"; 
+    }
+    // Queues the row and returns immediately; the next read overlaps the transfer.
+    pushRow(rowBuf, hdr.w);
+    resumeState.nextY = hdr.y + y + 1;
+    spiWaitMicros += micros() - t1;
+    bytesReadTotal += rowBytes;
+
+    // This row's buffer space is free again: top up once a whole batch has drained.
+    if (credit && granted < hdr.h && granted - (y + 1) <= CREDIT_INITIAL_ROWS - CREDIT_BATCH_ROWS) {
+      uint16_t grant = min((uint16_t)CREDIT_BATCH_ROWS, (uint16_t)(hdr.h - granted));
+      reader.client->printf("CREDIT %lu %u\n", (unsigned long)hdr.frameId, grant);
+      granted += grant;
+      grants++;
+    }
+  }
+
+  uint32_t t2 = micros();
+  panelEnd();
+  spiWaitMicros += micros() - t2;
+
+  // What the old read-then-push loop would have cost: network time plus the
+  // full SPI time of every row, with nothing overlapped.
+  uint32_t frameMicros = micros() - frameStart;
+  uint32_t spiMicros = (uint32_t)((uint64_t)bytesReadTotal * 8 * 1000000ULL / SPI_FREQUENCY);
+  uint32_t serialMicros = netMicros + spiMicros;
+  FRAME_LOG("[TIMING] %u bytes in %lu us (network %lu us, SPI %lu us est., blocked on SPI %lu us). "
+                "Unpipelined est. %lu us, overlap saved %ld us.\n",
+                bytesReadTotal, (unsigned long)frameMicros, (unsigned long)netMicros,
+                (unsigned long)spiMicros, (unsigned long)spiWaitMicros,
+                (unsigned long)serialMicros, (long)serialMicros - (long)frameMicros);
+  if (credit) {
+    FRAME_LOG("[CREDIT] %u grants for %u rows; starved of granted rows for %lu us (%lu%% of the frame).\n",
+              grants, hdr.h, (unsigned long)netMicros,
+              (unsigned long)((uint64_t)netMicros * 100 / (frameMicros ? frameMicros : 1)));
+  }
+  return NULL;
+}
+
+// --------------------------------------------------------
+// --- LOW-RESOLUTION FRAMES (ON-DEVICE UPSCALE) ---
+// --------------------------------------------------------
+uint16_t srcRowBuf[(IMAGE_WIDTH + 1) / 2];  // one source row, at most 160 pixels
+uint16_t scaledRows[3][IMAGE_WIDTH];        // source rows k-1, k, k+1, already widened to w
+
+// Mixes two RGB565 pixels, weight/32 of b. The channels are spread over a 32-bit
+// word (green in the upper half) with room to grow, so one multiply per pixel
+// scales all three. Must match blend_rgb565() in sensor_ai_display_loop.py.
+static inline uint16_t blend565(uint16_t a, uint16_t b, uint32_t weight) {
+  uint32_t wa = (a | ((uint32_t)a << 16)) & 0x07E0F81F;
+  uint32_t wb = (b | ((uint32_t)b << 16)) & 0x07E0F81F;
+  uint32_t mix = ((wa * (32 - weight) + wb * weight) >> 5) & 0x07E0F81F;
+  return (uint16_t)(mix | (mix >> 16));
+}
+
+// Output pixel i is centred on source coordinate (i + 0.5) / f - 0.5: between
+// source pixel i / f and one neighbour, which gets |2(i % f) + 1 - f| / 2f of the
+// weight (in 32nds). Returns the neighbour, clamped to the n source pixels.
+static inline uint16_t scaleNeighbour(uint16_t i, uint8_t shift, uint16_t n, uint32_t& weight) {
+  const int f = 1 << shift;
+  int d = 2 * (i & (f - 1)) + 1 - f;
+  weight = (uint32_t)abs(d) * 16 >> shift;
+  return constrain((int)(i >> shift) + (d < 0 ? -1 : 1), 0, n - 1);
+}
+
+// Streams a low-resolution frame's output rows. Source rows are widened once,
+// as they arrive, into a ring of three; each output row is then one of them or a
+// vertical blend of two. Shared by drawScaledRows() and benchmarkUpscale().
+struct Upscaler {
+  uint8_t  shift;
+  bool     bilinear;
+  uint16_t sw, sh, w;
+  uint16_t loaded;  // source rows widened so far
+
+  void begin(uint8_t factorShift, bool useBilinear, uint16_t sourceW, uint16_t sourceH, uint16_t outW) {
+    shift = factorShift;
+    bilinear = useBilinear;
+    sw = sourceW;
+    sh = sourceH;
+    w = outW;
+    loaded = 0;
+  }
+
+  // True while output row y needs a source row that has not been added yet.
+  bool needsRow(uint16_t y) const {
+    uint16_t last = y >> shift;
+    if (bilinear) {
+      uint32_t weight;
+      uint16_t nb = scaleNeighbour(y, shift, sh, weight);
+      if (nb > last) last = nb;
+    }
+    return loaded <= last;
+  }
+
+  void addRow(const uint16_t* src) {
+    uint16_t* dst = scaledRows[loaded++ % 3];
+    if (!bilinear) {
+      for (uint16_t x = 0; x < w; x++) dst[x] = src[x >> shift];
+      return;
+    }
+    for (uint16_t x = 0; x < w; x++) {
+      uint32_t weight;
+      uint16_t nb = scaleNeighbour(x, shift, sw, weight);
+      dst[x] = blend565(src[x >> shift], src[nb], weight);
+    }
+  }
+
+  void outputRow(uint16_t y, uint16_t* dst) const {
+    uint16_t k = y >> shift;
+    uint32_t weight = 0;
+    uint16_t nb = bilinear ? scaleNeighbour(y, shift, sh, weight) : k;
+    const uint16_t* a = scaledRows[k % 3];
+    if (nb == k) {
+      memcpy(dst, a, (size_t)w * 2);
+      return;
+    }
+    const uint16_t* b = scaledRows[nb % 3];
+    for (uint16_t x = 0; x < w; x++) dst[x] = blend565(a[x], b[x], weight);
+  }
+};
+Upscaler upscaler;
+
+const char* drawScaledRows(PayloadReader& reader, const FrameHeader& hdr) {
+  const uint8_t shift = scaleFactor(hdr) == 4 ? 2 : 1;
+  const size_t sourceRowBytes = (size_t)sourceWidth(hdr) * 2;
+  upscaler.begin(shift, hdr.scale & SCALE_BILINEAR, sourceWidth(hdr), sourceHeight(hdr), hdr.w);
+
+  uint32_t frameStart = micros();
+  uint32_t netMicros = 0;
+  uint32_t scaleMicros = 0;
+  const char* error = NULL;
+
+  panelBegin(hdr);
+
+  for (uint16_t y = 0; y < hdr.h && !error; y++) {
+    while (upscaler.needsRow(y)) {
+      uint32_t t0 = micros();
+      if (!reader.read(srcRowBuf, sourceRowBytes)) { error = "short"; break; }
+      uint32_t t1 = micros();
+      upscaler.addRow(srcRowBuf);
+      netMicros += t1 - t0;
+      scaleMicros += micros() - t1;
+    }
+    if (error) break;
+    uint32_t t2 = micros();
+    uint16_t* rowBuf = rowTarget(hdr, y);
+    upscaler.outputRow(y, rowBuf);
+    scaleMicros += micros() - t2;
+    pushRow(rowBuf, hdr.w);
+  }
+
+  panelEnd();
+  if (error) {
+    Serial.printf("FATAL ERROR: Incomplete read at source row %u of a scaled frame. Aborting.\n", upscaler.loaded);
+    return error;
+  }
+
+  FRAME_LOG("[TIMING] %ux %s frame: %ux%u source, %lu bytes (%.1f%% of raw) in %lu us "
+            "(network %lu us, upscale %lu us).\n",
+            1 << shift, (hdr.scale & SCALE_BILINEAR) ? "bilinear" : "nearest", upscaler.sw, upscaler.sh,
+            (unsigned long)hdr.payloadLen, 100.0f * hdr.payloadLen / ((uint32_t)hdr.w * hdr.h * 2),
+            (unsigned long)(micros() - frameStart), (unsigned long)netMicros, (unsigned long)scaleMicros);
+  return NULL;
+}
+
+// Times the upscale kernels alone for a full 320x170 frame (no network, no SPI):
+// a synthetic gradient source, each output row written to a line buffer.
+// The reply to "BENCH_SCALE" on the sensor port.
+String benchmarkUpscale() {
+  char line[160];
+  size_t len = snprintf(line, sizeof(line), "SCALE us_per_frame");
+  for (uint8_t shift = 1; shift <= 2; shift++) {
+    for (int bilinear = 0; bilinear <= 1; bilinear++) {
+      const uint16_t sw = (IMAGE_WIDTH + (1 << shift) - 1) >> shift;
+      const uint16_t sh = (IMAGE_HEIGHT + (1 << shift) - 1) >> shift;
+      upscaler.begin(shift, bilinear, sw, sh, IMAGE_WIDTH);
+      uint32_t start = micros();
+      for (uint16_t y = 0; y < IMAGE_HEIGHT; y++) {
+        while (upscaler.needsRow(y)) {
+          for (uint16_t x = 0; x < sw; x++) srcRowBuf[x] = (uint16_t)((x * 31 / sw) << 11 | (upscaler.loaded * 63 / sh) << 5);
+          upscaler.addRow(srcRowBuf);
+        }
+        upscaler.outputRow(y, lineBufs[0]);
+      }
+      len += snprintf(line + len, sizeof(line) - len, " %s%u=%lu", bilinear ? "bilinear" : "nearest",
+                      1 << shift, (unsigned long)(micros() - start));
+    }
+  }
+  return String(line);
+}
+
+// Decode cost of the last JPEG or palettized frame, as its [TIMING] line prints
+// it. "GET_TIMING" on the sensor port returns it, so the host benchmarks report
+// what the ESP32 measured rather than a host-side stand-in.
+struct DecodeTiming {
+  uint32_t frameId;
+  const char* kind;       // "jpeg", "pal8" or "pal4"; NULL until such a frame is drawn
+  uint32_t payloadLen;
+  uint32_t decodeMicros;  // TJpgDec decode and panel writes, or LUT expansion alone
+};
+DecodeTiming lastDecode = { 0, NULL, 0, 0 };
+
+// "TIMING <id> <kind> <bytes> <us>", or "TIMING none".
+String decodeTimingLine() {
+  if (!lastDecode.kind) return String("TIMING none");
+  char line[64];
+  snprintf(line, sizeof(line), "TIMING %lu %s %lu %lu", (unsigned long)lastDecode.frameId, lastDecode.kind,
+           (unsigned long)lastDecode.payloadLen, (unsigned long)lastDecode.decodeMicros);
+  return String(line);
+}
+
+// Reads the palette, then expands each row of indices to RGB565 through
+// paletteLut just before it is queued for DMA. The expansion time is reported
+// next to the network time so it can be checked that it never dominates.
+const char* drawIndexedRows(PayloadReader& reader, const FrameHeader& hdr) {
+  const uint32_t maxEntries = (hdr.format == PIXFMT_PAL8) ? 256 : 16;
+  const uint32_t rowBytes = indexRowBytes(hdr);
+
+  uint16_t entries = 0;
+  if (!reader.read(&entries, 2)) return "short";
+  if (entries == 0 || entries > maxEntries || reader.remaining != entries * 2u + rowBytes * hdr.h) return "palette";
+  memset(paletteLut, 0, sizeof(paletteLut));
+  if (!reader.read(paletteLut, entries * 2)) return "short";
+
+  uint32_t frameStart = micros();
+  uint32_t netMicros = 0;
+  uint32_t expandMicros = 0;
+  const char* error = NULL;
+
+  panelBegin(hdr);
+
+  for (int y = 0; y < hdr.h; y++) {
+    uint32_t t0 = micros();
+    if (!reader.read(indexBuf, rowBytes)) { error = "short"; break; }
+    uint32_t t1 = micros();
+
+    uint16_t* rowBuf = rowTarget(hdr, y);
+    if (hdr.format == PIXFMT_PAL8) {
+      for (int x = 0; x < hdr.w; x++) rowBuf[x] = paletteLut[indexBuf[x]];
+    } else {
+      int x = 0;
+      for (uint32_t i = 0; i < rowBytes; i++) {
+        rowBuf[x++] = paletteLut[indexBuf[i] >> 4];
+        if (x < hdr.w) rowBuf[x++] = paletteLut[indexBuf[i] & 0x0F];
+      }
+    }
+    uint32_t t2 = micros();
+    netMicros += t1 - t0;
+    expandMicros += t2 - t1;
+
+    pushRow(rowBuf, hdr.w);
+  }
+
+  panelEnd();
+  if (error) return error;
+
+  lastDecode = { hdr.frameId, hdr.format == PIXFMT_PAL8 ? "pal8" : "pal4", hdr.payloadLen, expandMicros };
+  FRAME_LOG("[TIMING] %s frame: %u colours, %lu bytes (%.1f%% of raw) in %lu us "
+                "(network %lu us, LUT expansion %lu us).\n",
+                hdr.format == PIXFMT_PAL8 ? "PAL8" : "PAL4", entries, (unsigned long)hdr.payloadLen,
+                100.0f * hdr.payloadLen / ((uint32_t)hdr.w * hdr.h * 2), (unsigned long)(micros() - frameStart),
+                (unsigned long)netMicros, (unsigned long)expandMicros);
+  return NULL;
+}
+
+// Decodes a PackBits-style RLE stream straight into the line buffers, so the
+// full frame never exists in RAM. Control byte c:
+//   0x00-0x7F  literal: c+1 pixels follow
+//   0x80-0xFF  run: the next pixel is repeated c-0x80+2 times
+const char* drawRleRows(PayloadReader& reader, const FrameHeader& hdr) {
+  const uint32_t totalPixels = (uint32_t)hdr.w * hdr.h;
+  uint32_t frameStart = micros();
+  uint32_t produced = 0;
+  int row = 0;
+  size_t col = 0;
+  uint16_t* rowBuf = rowTarget(hdr, 0);
+  const char* error = NULL;
+
+  panelBegin(hdr);
+
+  while (produced < totalPixels && !error) {
+    uint8_t ctrl;
+    uint16_t runPixel = 0;
+    if (!reader.read(&ctrl, 1)) { error = "short"; break; }
+    bool isRun = ctrl >= 0x80;
+    uint32_t count = isRun ? (ctrl - 0x80 + 2) : (ctrl + 1);
+    if (isRun && !reader.read(&runPixel, 2)) { error = "short"; break; }
+    if (produced + count > totalPixels) { error = "rle"; break; }
+
+    while (count > 0) {
+      size_t n = min((size_t)count, hdr.w - col);
+      if (isRun) {
+        for (size_t i = 0; i < n; i++) rowBuf[col + i] = runPixel;
+      } else if (!reader.read(rowBuf + col, n * 2)) {
+        error = "short";
+        break;
+      }
+      col += n;
+      count -= n;
+      produced += n;
+
+      if (col == hdr.w) {
+        pushRow(rowBuf, hdr.w);
+        row++;
+        col = 0;
+        if (row < hdr.h) rowBuf = rowTarget(hdr, row);
+      }
+    }
+  }
+
+  panelEnd();
+
+  if (!error && reader.remaining != 0) error = "length";
+  if (error) {
+    Serial.printf("FATAL ERROR: RLE decode failed at row %d (%s). Aborting.\n", row, error);
+    return error;
+  }
+  FRAME_LOG("[TIMING] RLE frame: %lu bytes -> %lu pixels (%.1f%% of raw) in %lu us.\n",
+                (unsigned long)hdr.payloadLen, (unsigned long)totalPixels,
+                100.0f * hdr.payloadLen / (totalPixels * 2), (unsigned long)(micros() - frameStart));
+  return NULL;
+}
+
+// TJpg_Decoder hands over one MCU block at a time. pushImageDMA() copies it into
+// the idle line buffer, so decoding the next block overlaps the SPI transfer.
+static size_t jpegBlockCount = 0;
+
+bool jpegBlockOutput(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* bitmap) {
+  if (back.pixels) {
+    jpegBlockCount++;
+    pushBlock(bitmap, x, y, w, h);
+  } else {
+    tft.pushImageDMA(x, y, w, h, bitmap, lineBufs[jpegBlockCount++ % LINE_BUFFER_COUNT]);
+  }
+  return true;
+}
+
+// Receives the whole (small) JPEG, verifies its CRC, then decodes it to the panel.
+const char* drawJpeg(PayloadReader& reader, const FrameHeader& hdr) {
+  uint8_t* jpeg = (uint8_t*)malloc(hdr.payloadLen);
+  if (!jpeg) return "memory";
+
+  uint32_t t0 = micros();
+  if (!reader.read(jpeg, hdr.payloadLen)) { free(jpeg); return "short"; }
+  uint32_t t1 = micros();
+
+  // The payload is complete, so a corrupt frame can be rejected before drawing.
+  uint16_t jpegW = 0, jpegH = 0;
+  const char* error = NULL;
+  if (reader.crc != hdr.crc32) error = "crc";
+  else if (TJpgDec.getJpgSize(&jpegW, &jpegH, jpeg, hdr.payloadLen) != JDR_OK) error = "jpeg";
+  else if (jpegW != hdr.w || jpegH != hdr.h) error = "geometry";
+  if (error) {
+    free(jpeg);
+    return error;
+  }
+
+  jpegBlockCount = 0;
+  if (!back.pixels) tft.startWrite();
+  JRESULT result = TJpgDec.drawJpg(hdr.x, hdr.y, jpeg, hdr.payloadLen);
+  panelEnd();
+  uint32_t t2 = micros();
+  free(jpeg);
+
+  if (result != JDR_OK) return "jpeg";
+  lastDecode = { hdr.frameId, "jpeg", hdr.payloadLen, t2 - t1 };
+  FRAME_LOG("[TIMING] JPEG frame: %lu bytes (%.1f%% of raw) received in %lu us, %u MCU blocks decoded in %lu us.\n",
+                (unsigned long)hdr.payloadLen, 100.0f * hdr.payloadLen / ((uint32_t)hdr.w * hdr.h * 2),
+                (unsigned long)(t1 - t0), jpegBlockCount, (unsigned long)(t2 - t1));
+  return NULL;
+}
+
+// Applies a delta frame: every tile gets its own address window, so panel
+// write time scales with the number of changed tiles, not the screen size.
+const char* drawTiles(PayloadReader& reader, const FrameHeader& hdr) {
+  uint32_t frameStart = micros();
+  size_t tileCount = 0;
+  size_t pixelCount = 0;
+
+  if (!back.pixels) tft.startWrite();
+  const char* error = NULL;
+
+  while (reader.remaining > 0) {
+    TileHeader tile;
+    if (!reader.read(&tile, sizeof(tile))) { error = "short"; break; }
+    if (tile.w == 0 || tile.h == 0 || (size_t)tile.w * tile.h > TILE_MAX_PIXELS ||
+        tile.x < hdr.x || tile.y < hdr.y ||
+        (uint32_t)tile.x + tile.w > (uint32_t)hdr.x + hdr.w ||
+        (uint32_t)tile.y + tile.h > (uint32_t)hdr.y + hdr.h) {
+      Serial.printf("FATAL ERROR: Tile %u %ux%u at (%u,%u) outside frame. Aborting.\n",
+                    tileCount, tile.w, tile.h, tile.x, tile.y);
+      error = "tile";
+      break;
+    }
+
+    // Receive into the idle buffer while the previous tile is still on the bus.
+    uint16_t* tileBuf = lineBufs[tileCount % LINE_BUFFER_COUNT];
+    size_t tilePixels = (size_t)tile.w * tile.h;
+    if (!reader.read(tileBuf, tilePixels * 2)) {
+      Serial.printf("FATAL ERROR: Incomplete read in tile %u. Aborting.\n", tileCount);
+      error = "short";
+      break;
+    }
+
+    pushBlock(tileBuf, tile.x, tile.y, tile.w, tile.h);
+    tileCount++;
+    pixelCount += tilePixels;
+  }
+
+  panelEnd();
+
+  if (!error) {
+    FRAME_LOG("[TIMING] Delta frame: %u tiles, %u pixels (%u%% of screen) in %lu us.\n",
+                  tileCount, pixelCount, (unsigned)(pixelCount * 100 / (IMAGE_WIDTH * IMAGE_HEIGHT)),
+                  (unsigned long)(micros() - frameStart));
+  }
+  return error;
+}
+
+// Where a frame's long reads land, for the [RX] log: RGB565 rows are received in
+// place (rowTarget()), everything else into the decoder's own input buffer.
+const char* rxTargetName(const FrameHeader& hdr) {
+  bool inPlace = hdr.format == PIXFMT_RGB565 && scaleFactor(hdr) == 1 &&
+                 (hdr.encoding == ENC_RAW || hdr.encoding == ENC_RLE);
+  if (!inPlace) return "decoder input buffers";
+  return back.pixels ? "the back buffer" : "DMA line buffers";
+}
+
+// Handles one message (frame or resume query) from the image connection.
+void drawImageFromClient(WiFiClient& client, SessionRx& rx) {
+  FRAME_LOG("\n[SERVER 8080] Receiving image data from Python...\n");
+  noteHostActivity();
+
+  FrameHeader hdr;
+  PayloadReader reader;
+  bool legacy = false;
+  const uint32_t directStart = rx.directBytes;
+  const uint32_t stagedStart = rx.stagedBytes;
+  if (!receiveFrameHeader(client, rx, hdr, reader, legacy)) {
+    Serial.println("FATAL ERROR: Connection closed before a frame header arrived.");
+    return;
+  }
+
+  if (memcmp(hdr.magic, STREAM_MAGIC, 4) == 0) {
+    startStream(client, rx);
+    if (!stream.active && stream.undrawn) {
+      // The stream ended on skipped frames; show what the back buffer holds.
+      presentBackBuffer(stream.undrawnX0, stream.undrawnY0,
+                        stream.undrawnX1 - stream.undrawnX0, stream.undrawnY1 - stream.undrawnY0);
+      stream.undrawn = false;
+    }
+    return;
+  }
+
+  if (memcmp(hdr.magic, CACHE_MAGIC, 4) == 0) {
+    answerCacheQuery(client, rx);
+    return;
+  }
+
+  if (memcmp(hdr.magic, RESUME_MAGIC, 4) == 0) {
+    answerResumeQuery(client, hdr.frameId);
+    // The rest of the frame (or the whole frame, if unknown) follows on this connection.
+    if (!receiveFrameHeader(client, rx, hdr, reader, legacy)) {
+      Serial.println("FATAL ERROR: Connection closed after resume query.");
+      return;
+    }
+  }
+
+  const char* error = validateFrameHeader(hdr);
+  if (!error && (hdr.flags & FRAME_FLAG_CONTINUATION) &&
+      !(resumeState.valid && resumeState.frameId == hdr.frameId && resumeState.nextY == hdr.y &&
+        resumeState.x == hdr.x && resumeState.w == hdr.w && resumeState.endY == hdr.y + hdr.h)) {
+    error = "resume";
+  }
+  if (error) {
+    // Rejected before touching the panel; the stream cannot be resynchronised.
+    Serial.printf("FATAL ERROR: Rejected frame %lu (%s).\n", (unsigned long)hdr.frameId, error);
+    sendFrameAck(client, hdr, error);
+    client.stop();
+    return;
+  }
+  FRAME_LOG("[SERVER 8080] Frame %lu: %ux%u at (%u,%u), %lu payload bytes%s.\n",
+                (unsigned long)hdr.frameId, hdr.w, hdr.h, hdr.x, hdr.y, (unsigned long)hdr.payloadLen,
+                legacy ? " (legacy, no header)" : (hdr.flags & FRAME_FLAG_CONTINUATION) ? " (continuation)" : "");
+
+  // A new frame makes any older interrupted frame stale; its committed rows are undone.
+  if (!(hdr.flags & FRAME_FLAG_CONTINUATION) && resumeState.valid) {
+    resumeState.valid = false;
+    if (back.pixels) discardFailedRows(resumeState.x, resumeState.startY, resumeState.w, resumeState.endY - resumeState.startY);
+  }
+
+  if (hdr.encoding == ENC_TILES && overlapsStale(hdr.x, hdr.y, hdr.w, hdr.h)) {
+    // The tiles would be presented together with rows of a failed frame; the host resends in full.
+    Serial.printf("[BACK BUFFER] Delta frame %lu refused: a failed frame left rows under it.\n", (unsigned long)hdr.frameId);
+    if (!drainPayload(reader)) {
+      client.stop();
+      return;
+    }
+    sendFrameAck(client, hdr, "stale");
+    return;
+  }
+
+  // Without a back buffer, drawing is presenting, so a stream frame takes its slot first.
+  const bool paced = stream.active && !legacy;
+  if (paced && !back.pixels && !waitForStreamSlot(hdr.encoding == ENC_TILES)) {
+    if (!drainPayload(reader)) {
+      client.stop();
+      return;
+    }
+    sendFrameAck(client, hdr, "late");
+    return;
+  }
+
+  switch (hdr.encoding) {
+    case ENC_TILES: error = drawTiles(reader, hdr); break;
+    case ENC_RLE:   error = drawRleRows(reader, hdr); break;
+    case ENC_JPEG:  error = drawJpeg(reader, hdr); break;
+    default:
+      if (hdr.format != PIXFMT_RGB565) {
+        error = drawIndexedRows(reader, hdr);
+      } else {
+        error = scaleFactor(hdr) > 1 ? drawScaledRows(reader, hdr) : drawRawRows(reader, hdr);
+      }
+      break;
+  }
+  if (error) {
+    if (!legacy && resumeState.valid && resumeState.frameId == hdr.frameId && strcmp(error, "short") == 0) {
+      // Keep the committed rows (on screen, or in the back buffer); the host can continue from nextY.
+      markStale(hdr.x, hdr.y, hdr.w, hdr.h);
+      Serial.printf("[SERVER 8080] Frame %lu interrupted at row %u. Awaiting resume.\n",
+                    (unsigned long)hdr.frameId, resumeState.nextY);
+    } else if (back.pixels) {
+      // A failed continuation takes the rows before the break with it.
+      uint16_t y0 = (hdr.flags & FRAME_FLAG_CONTINUATION) ? resumeState.startY : hdr.y;
+      resumeState.valid = false;
+      discardFailedRows(hdr.x, y0, hdr.w, hdr.y + hdr.h - y0);
+      Serial.printf("[BACK BUFFER] Frame %lu abandoned; the last good image stays up.\n", (unsigned long)hdr.frameId);
+    } else {
       tft.fillScreen(TFT_RED); 
-      return; 
     }
-    tft.pushColors((uint16_t*)lineBuf, IMAGE_WIDTH, true); 
-    bytesReadTotal += bytesRead;
+    sendFrameAck(client, hdr, error);
+    client.stop();
+    return;
   }
-  
-  if (bytesReadTotal == EXPECTED_IMAGE_SIZE) {
-    Serial.println("Image drawn successfully!");
+
+  if (!legacy && reader.crc != hdr.crc32) {
+    Serial.printf("FATAL ERROR: CRC mismatch. Expected %08lx, computed %08lx.\n",
+                  (unsigned long)hdr.crc32, (unsigned long)reader.crc);
+    if (paced) {
+      // The stream's next deltas build on this frame: refuse them until a full frame covers it.
+      markStale(hdr.x, hdr.y, hdr.w, hdr.h);
+    } else if (back.pixels) {
+      uint16_t y0 = (hdr.flags & FRAME_FLAG_CONTINUATION) ? resumeState.startY : hdr.y;
+      resumeState.valid = false;
+      discardFailedRows(hdr.x, y0, hdr.w, hdr.y + hdr.h - y0);
+    }
+    if (!back.pixels) tft.fillScreen(TFT_MAGENTA); 
+    if (paced && back.pixels) stream.received++;  // its slot passes empty
+    sendFrameAck(client, hdr, "crc");
+    return;
+  }
+
+  // With a back buffer, receiving and decoding count against the frame's slot.
+  if (paced && back.pixels && !waitForStreamSlot(hdr.encoding == ENC_TILES)) {
+    markUndrawn(hdr.x, hdr.y, hdr.w, hdr.h);
+    sendFrameAck(client, hdr, "late");
+    return;
+  }
+
+  uint32_t presentCopied = 0;  // bytes presentBackBuffer() memcpy's into the line buffers
+  if (back.pixels) {
+    // A completed continuation presents the whole frame, including the rows before the break.
+    bool resumed = hdr.flags & FRAME_FLAG_CONTINUATION;
+    uint16_t x0 = hdr.x, w = hdr.w;
+    uint16_t y0 = resumed ? resumeState.startY : hdr.y;
+    uint16_t h = resumed ? resumeState.endY - y0 : hdr.h;
+    takeUndrawn(x0, y0, w, h);
+    uint32_t presentMicros = presentBackBuffer(x0, y0, w, h);
+    presentCopied = (uint32_t)w * h * 2;
+    FRAME_LOG("[PRESENT] %ux%u at (%u,%u) in %lu us.\n", w, h, x0, y0, (unsigned long)presentMicros);
+  } else {
+    restoreOverlays(hdr.x, hdr.y, hdr.w, hdr.h);
+  }
+  FRAME_LOG("Image drawn successfully!\n");
+  uint32_t direct = rx.directBytes - directStart;
+  uint32_t staged = rx.stagedBytes - stagedStart;
+  FRAME_LOG("[RX] %lu bytes received straight into %s, %lu memcpy'd from staging, "
+            "%lu memcpy'd from the back buffer to present (%lu%% of the bytes received).\n",
+            (unsigned long)direct, rxTargetName(hdr), (unsigned long)staged, (unsigned long)presentCopied,
+            (unsigned long)((uint64_t)(staged + presentCopied) * 100 / (direct + staged ? direct + staged : 1)));
+  if (stream.active) recordStreamPresent();
+  if (!legacy) sendFrameAck(client, hdr, NULL);
+  if (frameCache.pending && frameCache.pendingFrameId == hdr.frameId) {
+    // A cached frame must come back at full resolution; low-resolution ones are not kept.
+    if (scaleFactor(hdr) == 1) {
+      storeCachedFrame();
+    } else {
+      frameCache.pending = false;
+    }
+  }
+}
+
+// --------------------------------------------------------
+// --- IMAGE SESSION HANDLER (KEEP-ALIVE) ---
+// --------------------------------------------------------
+// Returns true if a frame was handled, so loop() can skip its idle delay.
+bool serviceImageSession() {
+  if (imageServer.hasClient()) {
+    if (sessionOpen) {
+      Serial.printf("[SERVER 8080] New connection replaces session after %lu frames.\n", (unsigned long)sessionFrames);
+      imageSession.stop();
+    }
+    stream.active = false;  // a stream belongs to the session that started it
+    imageSession = imageServer.available();
+    imageSession.setNoDelay(true);  // acks go out immediately
+    sessionRx.begin(imageSession.fd());
+    sessionOpen = true;
+    sessionFrames = 0;
+    sessionLastActivity = millis();
+    Serial.printf("[SERVER 8080] Session opened by %s.\n", imageSession.remoteIP().toString().c_str());
+  }
+  if (!sessionOpen) return false;
+
+  // Bytes may wait in sessionRx's staging buffer that the socket no longer reports.
+  if (sessionRx.buffered() > 0 || imageSession.available() > 0) {
+    drawImageFromClient(imageSession, sessionRx);
+    sessionFrames++;
+    sessionLastActivity = millis();
+    return true;
+  }
+
+  if (!imageSession.connected() || millis() - sessionLastActivity > SESSION_IDLE_TIMEOUT_MS) {
+    Serial.printf("[SERVER 8080] Session closed after %lu frames (%lu bytes received directly, %lu staged).\n",
+                  (unsigned long)sessionFrames, (unsigned long)sessionRx.directBytes, (unsigned long)sessionRx.stagedBytes);
+    imageSession.stop();
+    sessionOpen = false;
+    stream.active = false;
+  }
+  return false;
+}
+
+// --------------------------------------------------------
+// --- MULTICAST FRAME RECEIVER ---
+// --------------------------------------------------------
+// Sends the sender either the missing row ranges or, once complete, an ACK.
+void sendMulticastReply(IPAddress host, uint16_t port) {
+  uint8_t reply[4 + 4 + 2 + MCAST_MAX_NACK_RANGES * 4];
+  uint16_t ranges = 0;
+  size_t len = 8 + 2;
+
+  if (!mcastFrame.complete) {
+    for (uint16_t row = 0; row < mcastFrame.totalRows && ranges < MCAST_MAX_NACK_RANGES; ) {
+      if (mcastFrame.rowReceived[row]) { row++; continue; }
+      uint16_t first = row;
+      while (row < mcastFrame.totalRows && !mcastFrame.rowReceived[row]) row++;
+      uint16_t count = row - first;
+      memcpy(reply + len, &first, 2);
+      memcpy(reply + len + 2, &count, 2);
+      len += 4;
+      ranges++;
+    }
+  }
+
+  memcpy(reply, mcastFrame.complete ? MCAST_ACK_MAGIC : MCAST_NACK_MAGIC, 4);
+  memcpy(reply + 4, &mcastFrame.frameId, 4);
+  memcpy(reply + 8, &ranges, 2);
+  frameUdp.beginPacket(host, port);
+  frameUdp.write(reply, mcastFrame.complete ? 8 : len);
+  frameUdp.endPacket();
+
+  if (!mcastFrame.complete) {
+    mcastFrame.nacksSent++;
+    mcastFrame.lastNackMillis = millis();
+  }
+}
+
+// Draws rows of a multicast packet into the back buffer, or straight to the panel.
+void drawMulticastRows(uint16_t firstRow, uint16_t rowCount, uint16_t* pixels) {
+  if (back.pixels) {
+    memcpy(back.pixels + (size_t)firstRow * IMAGE_WIDTH, pixels, (size_t)rowCount * IMAGE_WIDTH * 2);
   } else {
-    Serial.printf("FATAL ERROR: Final size mismatch. Expected %u, Read %u.\n", EXPECTED_IMAGE_SIZE, bytesReadTotal);
-    tft.fillScreen(TFT_MAGENTA); 
+    tft.startWrite();
+    tft.setAddrWindow(0, firstRow, IMAGE_WIDTH, rowCount);
+    tft.pushColors(pixels, (uint32_t)rowCount * IMAGE_WIDTH, true);
+    tft.endWrite();
+  }
+}
+
+// Drains waiting multicast packets, drawing each row range as it arrives.
+// Returns true if any packet was handled.
+bool serviceMulticast() {
+  bool handled = false;
+  int size;
+  while ((size = frameUdp.parsePacket()) > 0) {
+    handled = true;
+    if (size > MCAST_MAX_PACKET || size < (int)sizeof(McastHeader)) continue;
+    frameUdp.read(mcastPacket, size);
+    McastHeader pkt;
+    memcpy(&pkt, mcastPacket, sizeof(pkt));
+    if (memcmp(pkt.magic, MCAST_MAGIC, 4) != 0 || pkt.totalRows == 0 || pkt.totalRows > IMAGE_HEIGHT) continue;
+    mcastSenderIp = frameUdp.remoteIP();
+    mcastSenderPort = frameUdp.remotePort();
+    noteHostActivity();
+
+    if (!mcastFrame.active || pkt.frameId != mcastFrame.frameId) {
+      // A new frame id starts over; whatever is left of the old one is abandoned.
+      if (mcastFrame.active && !mcastFrame.complete && back.pixels) {
+        discardFailedRows(0, 0, IMAGE_WIDTH, mcastFrame.totalRows);
+      }
+      memset(&mcastFrame, 0, sizeof(mcastFrame));
+      mcastFrame.active = true;
+      mcastFrame.frameId = pkt.frameId;
+      mcastFrame.totalRows = pkt.totalRows;
+      mcastFrame.startMillis = millis();
+      markStale(0, 0, IMAGE_WIDTH, pkt.totalRows);  // until the frame is complete and presented
+    }
+    mcastFrame.lastPacketMillis = millis();
+    mcastFrame.silentNacks = 0;
+    mcastFrame.packets++;
+
+    if (pkt.type == MCAST_END) {
+      sendMulticastReply(mcastSenderIp, mcastSenderPort);
+      continue;
+    }
+
+    size_t expected = sizeof(McastHeader) + (size_t)pkt.rowCount * IMAGE_WIDTH * 2;
+    if (pkt.type != MCAST_DATA || pkt.rowCount == 0 || (size_t)size != expected ||
+        (uint32_t)pkt.firstRow + pkt.rowCount > mcastFrame.totalRows) continue;
+    // A repair packet may overlap rows this display already has: draw each
+    // run of rows still missing, and skip the packet only if none are.
+    uint16_t* pixels = (uint16_t*)(mcastPacket + sizeof(McastHeader));
+    uint16_t newRows = 0;
+    for (uint16_t r = 0; r < pkt.rowCount; ) {
+      if (mcastFrame.rowReceived[pkt.firstRow + r]) { r++; continue; }
+      uint16_t first = r;
+      while (r < pkt.rowCount && !mcastFrame.rowReceived[pkt.firstRow + r]) {
+        mcastFrame.rowReceived[pkt.firstRow + r] = true;
+        r++;
+      }
+      drawMulticastRows(pkt.firstRow + first, r - first, pixels + (size_t)first * IMAGE_WIDTH);
+      newRows += r - first;
+    }
+    if (newRows == 0) {
+      mcastFrame.duplicates++;  // a repair for another display
+      continue;
+    }
+    mcastFrame.rowsReceived += newRows;
+    if (!mcastFrame.complete && mcastFrame.rowsReceived == mcastFrame.totalRows) {
+      mcastFrame.complete = true;
+      uint32_t presentMicros = back.pixels ? presentBackBuffer(0, 0, IMAGE_WIDTH, mcastFrame.totalRows) : 0;
+      restoreOverlays(0, 0, IMAGE_WIDTH, mcastFrame.totalRows);
+      Serial.printf("[MULTICAST] Frame %lu complete in %lu ms: %lu packets, %lu duplicates, %lu NACKs sent, presented in %lu us.\n",
+                    (unsigned long)mcastFrame.frameId, (unsigned long)(millis() - mcastFrame.startMillis),
+                    (unsigned long)mcastFrame.packets, (unsigned long)mcastFrame.duplicates,
+                    (unsigned long)mcastFrame.nacksSent, (unsigned long)presentMicros);
+      sendMulticastReply(mcastSenderIp, mcastSenderPort);
+    }
+  }
+
+  // The END packet itself may be lost: ask for the gaps after a quiet period,
+  // and give the frame up once the host has stopped answering.
+  uint32_t now = millis();
+  if (mcastFrame.active && !mcastFrame.complete &&
+      now - mcastFrame.lastPacketMillis > MCAST_NACK_TIMEOUT_MS &&
+      now - mcastFrame.lastNackMillis > MCAST_NACK_TIMEOUT_MS) {
+    if (mcastFrame.silentNacks >= MCAST_MAX_SILENT_NACKS) {
+      Serial.printf("[MULTICAST] Frame %lu abandoned: %u of %u rows, no answer to %u NACKs.\n",
+                    (unsigned long)mcastFrame.frameId, mcastFrame.rowsReceived, mcastFrame.totalRows,
+                    mcastFrame.silentNacks);
+      if (back.pixels) discardFailedRows(0, 0, IMAGE_WIDTH, mcastFrame.totalRows);
+      mcastFrame.active = false;
+    } else {
+      mcastFrame.silentNacks++;
+      sendMulticastReply(mcastSenderIp, mcastSenderPort);
+    }
   }
+  return handled;
 }
 
 // --------------------------------------------------------
@@ -116,7 +1998,16 @@ void handleSensorRequest(WiFiClient client) {
 
     Serial.printf("\n[SERVER 8082] Received request: %s. Sending data...\n", request.c_str());
 
-    String data = getSensorReading();
+    String data;
+    if (request.equals("GET_STATS")) {
+      data = cacheStatsLine();
+    } else if (request.equals("BENCH_SCALE")) {
+      data = benchmarkUpscale();
+    } else if (request.equals("GET_TIMING")) {
+      data = decodeTimingLine();
+    } else {
+      data = getSensorReading();
+    }
     client.println(data); 
     
     Serial.print("[SERVER 8082] Sent data: ");
@@ -139,6 +2030,11 @@ void setup() {
   tft.setRotation(3); 
   tft.invertDisplay(true); 
   tft.fillScreen(TFT_BLACK); 
+  tft.setSwapBytes(true);  // host sends little-endian RGB565; pushPixelsDMA swaps in place
+  tft.initDMA();
+  TJpgDec.setJpgScale(1);
+  TJpgDec.setSwapBytes(false);  // native RGB565, swapped by pushImageDMA like every other path
+  TJpgDec.setCallback(jpegBlockOutput);
   pinMode(TFT_BL, OUTPUT);
   digitalWrite(TFT_BL, TFT_BACKLIGHT_ON);
 
@@ -152,21 +2048,45 @@ void setup() {
   Serial.println(image_transfer_port);
   Serial.print("Sensor Request Server started on port: ");
   Serial.println(sensor_request_port);
+  // Power save makes the radio skip multicast frames between DTIM beacons.
+  WiFi.setSleep(false);
+  frameUdp.beginMulticast(multicast_group, multicast_port);
+  Serial.print("Multicast Frame Receiver joined: ");
+  Serial.println(multicast_group.toString());
+#if USE_BACK_BUFFER
+  // After WiFi has taken its share of internal RAM.
+  allocateBackBuffer();
+#endif
+#if USE_SENSOR_OVERLAY
+  setupSensorOverlay();
+#endif
+#if USE_FRAME_CACHE
+  setupFrameCache();
+#endif
   Serial.println("Loop initialized. Awaiting Python polling request...");
 }
 
 void loop() {
-  // 1. Check for incoming IMAGE streaming connection (Port 8080)
-  WiFiClient imageClient = imageServer.available();
-  if (imageClient) {
-    drawImageFromClient(imageClient);
-  }
+  // 1. Service the IMAGE session, accepting a new connection if one is waiting (Port 8080)
+  bool busy = serviceImageSession();
+
+  // 2. Draw any multicast row packets (UDP 8090)
+  busy |= serviceMulticast();
   
-  // 2. Check for incoming SENSOR DATA REQUEST connection (Port 8082)
+  // 3. Check for incoming SENSOR DATA REQUEST connection (Port 8082)
   WiFiClient sensorClient = sensorRequestServer.available();
   if (sensorClient) {
     handleSensorRequest(sensorClient);
   }
+
+  // 4. Re-composite the sensor overlay if the reading changed (no network traffic)
+  updateSensorOverlay();
+
+#if USE_SLIDESHOW
+  // 5. Play cached frames while the host is away
+  if (!busy) serviceSlideshow();
+#endif
   
-  delay(100); 
+  // Back-to-back frames on an open session are not throttled.
+  if (!busy) delay(sessionOpen ? 1 : 100); 
 }
@@ -2,6 +2,15 @@ import os
 import sys
 from PIL import Image
 
+# The repo's native packer (rgb565_native/) does the whole image in one call;
+# without it (or numpy) the per-pixel loop below is used.
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+try:
+    import numpy as np
+    import rgb565_native
+except ImportError:
+    rgb565_native = None
+
 # --- CONFIGURATION ---
 TARGET_WIDTH = 320
 TARGET_HEIGHT = 240
@@ -25,6 +34,18 @@ def rgb_to_bgr565(r, g, b):
     
     return swapped_p16
 
+def image_to_bgr565_bytes(img):
+    """The image's pixels as byte-swapped BGR565, in memory order (2 bytes per pixel)."""
+    if rgb565_native is not None and rgb565_native.available():
+        return rgb565_native.pack(np.asarray(img), bgr=True, swap_bytes=True).astype('<u2').tobytes()
+
+    data = bytearray()
+    for r, g, b in img.getdata():
+        p16_swapped = rgb_to_bgr565(r, g, b)
+        # Low byte first, as the ESP32 stores it
+        data += bytes((p16_swapped & 0xFF, (p16_swapped >> 8) & 0xFF))
+    return bytes(data)
+
 def convert_image_to_c_array(input_path, output_path):
     """Opens an image, converts it to a 16-bit BGR565 C array, and writes the output file."""
     try:
@@ -38,7 +59,7 @@ def convert_image_to_c_array(input_path, output_path):
 
     # Resize and convert to RGB
     img = img.resize((TARGET_WIDTH, TARGET_HEIGHT)).convert("RGB")
-    pixels = list(img.getdata())
+    pixel_bytes = image_to_bgr565_bytes(img)
 
     print(f"Converting {os.path.basename(input_path)} to {OUTPUT_FILENAME} ({TARGET_WIDTH}x{TARGET_HEIGHT} pixels)...")
 
@@ -52,20 +73,9 @@ def convert_image_to_c_array(input_path, output_path):
         f'const uint8_t {IMAGE_NAME}_map[] = {{\n'
     )
 
-    # Process all pixels and format as C array
-    line_count = 0
-    for r, g, b in pixels:
-        p16_swapped = rgb_to_bgr565(r, g, b)
-        
-        # Write the 16-bit value as two 8-bit hex values (Low Byte, High Byte)
-        byte_low = p16_swapped & 0xFF
-        byte_high = (p16_swapped >> 8) & 0xFF
-        
-        c_code += f'0x{byte_low:02X}, 0x{byte_high:02X}, '
-        line_count += 1
-        
-        if line_count % 16 == 0:
-            c_code += '\n'
+    # Format as C array: two hex bytes per pixel, 16 pixels per line
+    hex_bytes = [f'0x{byte:02X}, ' for byte in pixel_bytes]
+    c_code += '\n'.join(''.join(hex_bytes[i:i + 32]) for i in range(0, len(hex_bytes), 32))
 
     c_code = c_code.rstrip(', \n') + '\n};\n\n'
     
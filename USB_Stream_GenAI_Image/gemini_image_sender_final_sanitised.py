@@ -1,9 +1,16 @@
+import argparse
+import binascii
+import os
+import random
 import serial
+import threading
 import time
 import numpy as np
 import sys
 import io
-from PIL import Image
+import struct
+import zlib
+from PIL import Image, ImageDraw, ImageFont
 import requests
 import base64
 
@@ -19,12 +26,56 @@ STABILITY_MODEL = "stable-diffusion-xl"
 COM_PORT = 'COM17' 
 BAUD_RATE = 115200 
 START_COMMAND = "START_IMAGE_TRANSFER\n" 
+START_FRAME_COMMAND = "START_FRAME\n"  # followed by a framed image, answered with OK/ERR
+START_COBS_FRAME_COMMAND = "START_COBS_FRAME\n"  # followed by COBS row packets, each ACKed or NACKed
+# "cobs" sends one CRC-checked packet per row and resends only damaged rows;
+# "frame" sends a single RLE/raw frame that is redone as a whole on any error.
+SERIAL_TRANSPORT = "cobs"
+# With the COBS transport, send rows in four interlace passes (every 8th row first) so a
+# blocky preview of the whole image appears after about 1/8 of the bytes.
+INTERLACED = True
+ACK_TIMEOUT = 30 # seconds; a raw frame alone takes ~9.5 s at 115200 baud
+MAX_SEND_ATTEMPTS = 3
+
+# --- Baud Negotiation (must match SUPPORTED_BAUD_RATES in DIYMORE_LCD_USB.ino) ---
+# The link opens at BAUD_RATE; each candidate is tried fastest first and kept only if
+# the ESP32 receives a CRC-checked test pattern intact at that rate.
+NEGOTIATE_BAUD = True
+BAUD_CANDIDATES = [2000000, 1500000, 921600, 460800, 230400]
+BAUD_TEST_BYTES = 4096
+BAUD_BENCH_BYTES = 32768
+BAUD_SWITCH_SETTLE = 0.05 # seconds
+BAUD_LEASE = 3 # seconds of silence after which the ESP32 is back at BAUD_RATE
+# RTS/CTS needs a USB-UART adapter wired to the ESP32's RTS/CTS pins (USE_HW_FLOW_CONTROL in the sketch).
+USE_HW_FLOW_CONTROL = False
 
 # --- LCD Image Dimensions ---
 IMAGE_WIDTH = 320  
 IMAGE_HEIGHT = 170  
 EXPECTED_SIZE = IMAGE_WIDTH * IMAGE_HEIGHT * 2 
 
+# --- Frame Protocol (must match FrameHeader in DIYMORE_LCD_USB.ino) ---
+FRAME_MAGIC = b'IMGF'
+FRAME_PROTOCOL_VERSION = 1
+FRAME_HEADER_FORMAT = '<4sBBBBHHHHHHIII'
+PIXFMT_RGB565 = 0
+ENC_RAW = 0
+ENC_RLE = 2
+COBS_ROW_END = 0xFFFF
+FRAME_FLAG_INTERLACED = 0x0002
+
+# --- Binary Commands (must match CMD_* in DIYMORE_LCD_USB.ino) ---
+# 0xA5 | opcode | len | payload | CRC16 over opcode, len and payload; replies are text lines.
+CMD_BINARY_SYNC = 0xA5
+CMD_PING = 0x01
+CMD_STATS = 0x02
+CMD_DRAW_REGION = 0x03
+CMD_SET_FORMAT = 0x04
+PING_COUNT = 200
+BADGE_SIZE = (96, 20)  # --badge: drawn with DRAW_REGION in the top-right corner
+COBS_MAX_ROUNDS = 10
+COBS_REPLY_TIMEOUT = 2 # seconds of silence before a round is considered finished
+
 # --- User Input Prompt ---
 PROMPT = "An epic fantasy landscape featuring a giant floating island and twin moons, highly detailed digital painting."
 
@@ -86,6 +137,19 @@ def generate_image_from_prompt(prompt, api_key):
 # -----------------------------------------------------------------------------
 
 
+def to_rgb565(pil_image):
+    """(H, W) uint16 RGB565 pixels of the image at its own size."""
+    np_array = np.array(pil_image.convert("RGB"), dtype=np.uint8)
+    
+    R = np_array[:, :, 0]
+    G = np_array[:, :, 1]
+    B = np_array[:, :, 2]
+
+    # Convert 8-bit channels to 5-6-5 bits and pack into 16-bit integer
+    return (R.astype(np.uint16) >> 3) << 11 | \
+           (G.astype(np.uint16) >> 2) << 5 | \
+           (B.astype(np.uint16) >> 3)
+
 def convert_to_rgb565_raw(pil_image):
     """Resizes and converts the PIL Image to raw 16-bit RGB565 binary data."""
     
@@ -96,21 +160,8 @@ def convert_to_rgb565_raw(pil_image):
     else:
         img_resized = pil_image
 
-    # 2. Convert to NumPy array
-    img_rgb = img_resized.convert("RGB")
-    np_array = np.array(img_rgb, dtype=np.uint8)
-    
-    R = np_array[:, :, 0]
-    G = np_array[:, :, 1]
-    B = np_array[:, :, 2]
-
-    # 3. Convert 8-bit channels to 5-6-5 bits and pack into 16-bit integer
-    rgb565 = (R.astype(np.uint16) >> 3) << 11 | \
-             (G.astype(np.uint16) >> 2) << 5 | \
-             (B.astype(np.uint16) >> 3)
-             
-    # 4. Convert the 16-bit array to raw bytes (Little Endian '<u2')
-    raw_data = rgb565.astype('<u2').tobytes()
+    # 2. Convert to RGB565 and then to raw bytes (Little Endian '<u2')
+    raw_data = to_rgb565(img_resized).astype('<u2').tobytes()
     
     if len(raw_data) != EXPECTED_SIZE:
         raise ValueError(f"Conversion failed: Expected {EXPECTED_SIZE} bytes, got {len(raw_data)}.")
@@ -118,32 +169,350 @@ def convert_to_rgb565_raw(pil_image):
     print(f"[CONVERSION] Success. Converted {len(raw_data)} bytes to RGB565.")
     return raw_data
 
+def encode_rle(pixels):
+    """PackBits-style RLE over 16-bit pixels, matching drawRleRows() on the ESP32.
+
+    Control byte 0x00-0x7F: that many + 1 literal pixels follow.
+    Control byte 0x80-0xFF: the following pixel repeats (c - 0x80 + 2) times.
+
+    The same encoder is copied in sensor_ai_display_loop.py, as each script runs
+    standalone: keep both copies in step with each other and with drawRleRows() in the sketches.
+    """
+    flat = np.ascontiguousarray(pixels, dtype='<u2').ravel()
+    le = flat.tobytes()
+    count = len(flat)
+    starts = np.concatenate(([0], np.flatnonzero(flat[1:] != flat[:-1]) + 1))
+    lengths = np.diff(np.concatenate((starts, [count])))
+
+    out = bytearray()
+
+    def flush_literals(begin, end):
+        while begin < end:
+            n = min(128, end - begin)
+            out.append(n - 1)
+            out.extend(le[begin * 2:(begin + n) * 2])
+            begin += n
+
+    literal_start = None
+    for start, length in zip(starts.tolist(), lengths.tolist()):
+        if length == 1:
+            if literal_start is None:
+                literal_start = start
+            continue
+        if literal_start is not None:
+            flush_literals(literal_start, start)
+            literal_start = None
+        while length >= 2:
+            n = min(129, length)
+            out.append(0x80 + n - 2)
+            out += le[start * 2:start * 2 + 2]
+            start += n
+            length -= n
+        if length == 1:
+            literal_start = start
+    if literal_start is not None:
+        flush_literals(literal_start, count)
+    return bytes(out)
+
+def frame_header(encoding, payload, frame_id, flags=0):
+    return struct.pack(FRAME_HEADER_FORMAT, FRAME_MAGIC, FRAME_PROTOCOL_VERSION,
+                       PIXFMT_RGB565, encoding, 0, flags, 0, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT,
+                       len(payload), frame_id, zlib.crc32(payload) & 0xFFFFFFFF)
+
+def encode_frame(raw_data, frame_id=1, baud=BAUD_RATE):
+    """Picks raw or RLE, whichever is smaller, and prepends the 32-byte frame header."""
+    rle_payload = encode_rle(np.frombuffer(raw_data, dtype='<u2'))
+    if len(rle_payload) < len(raw_data):
+        payload, encoding, label = rle_payload, ENC_RLE, "RLE"
+    else:
+        payload, encoding, label = raw_data, ENC_RAW, "raw"
+    print(f"[ENCODING] Sending {label}: {len(payload)} bytes ({100 * len(payload) / len(raw_data):.1f}% of raw), "
+          f"~{len(payload) * 10 / baud:.1f} s at {baud} baud.")
+    return frame_header(encoding, payload, frame_id) + payload
+
+# -----------------------------------------------------------------------------
+# *** COBS ROW TRANSPORT (must match drawCobsFrameFromSerial in DIYMORE_LCD_USB.ino) ***
+# -----------------------------------------------------------------------------
+def crc16(data):
+    """CRC-16/CCITT-FALSE, matching crc16Ccitt() on the ESP32."""
+    return binascii.crc_hqx(data, 0xFFFF)
+
+def cobs_encode(data):
+    """Consistent Overhead Byte Stuffing: removes every 0x00 so it can delimit packets."""
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out.append(len(block) + 1)
+            out += block
+            block.clear()
+            continue
+        block.append(byte)
+        if len(block) == 254:
+            out.append(255)
+            out += block
+            block.clear()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("malformed COBS packet")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+def cobs_packet(body):
+    """One wire packet: COBS(body + CRC16) followed by the 0x00 delimiter."""
+    return cobs_encode(body + struct.pack('<H', crc16(body))) + b'\x00'
+
+def binary_command(opcode, payload=b''):
+    body = bytes((opcode, len(payload))) + payload
+    return bytes((CMD_BINARY_SYNC,)) + body + struct.pack('<H', crc16(body))
+
+def query_stats(ser):
+    """Returns the ESP32's STATS line as a dict of ints."""
+    ser.write(binary_command(CMD_STATS))
+    reply = read_reply(ser, ("STATS ",), 2)
+    return {k: int(v) for k, v in (item.split('=') for item in reply.split()[1:])}
+
+def interlace_pass(row):
+    """Pass (0-3) in which a row is sent: every 8th row from 0, every 8th from 4, every 4th from 2, odd rows."""
+    if row % 8 == 0:
+        return 0
+    if row % 8 == 4:
+        return 1
+    return 2 if row % 2 == 0 else 3
+
+INTERLACE_SPANS = (8, 4, 2, 1)  # rows each pass's row stands in for, as interlaceSpan() in the sketch
+
+def interlaced_order(rows):
+    return sorted(rows, key=lambda r: (interlace_pass(r), r))
+
+def send_frame_cobs(ser, raw_data, frame_id=1, interlaced=INTERLACED):
+    """Streams a raw frame as per-row COBS packets and resends rows until all are ACKed.
+
+    Returns (ok, stats) where stats counts rounds, resent rows and wire bytes, and holds
+    the ESP32's time to the interlaced preview and to the full frame when it reports them.
+    """
+    row_bytes = IMAGE_WIDTH * 2
+    rows = [cobs_packet(struct.pack('<H', r) + raw_data[r * row_bytes:(r + 1) * row_bytes])
+            for r in range(IMAGE_HEIGHT)]
+    end_packet = cobs_packet(struct.pack('<H', COBS_ROW_END))
+    stats = {"rounds": 0, "rows_resent": 0, "nacks": 0, "wire_bytes": 0, "preview_ms": None, "frame_ms": None}
+    order = interlaced_order if interlaced else sorted
+
+    ser.reset_input_buffer()
+    ser.write(START_COBS_FRAME_COMMAND.encode())
+    flags = FRAME_FLAG_INTERLACED if interlaced else 0
+    header = cobs_packet(frame_header(ENC_RAW, raw_data, frame_id, flags))
+    ser.write(header)
+    stats["wire_bytes"] += len(header)
+
+    pending = set(range(IMAGE_HEIGHT))
+    for round_number in range(1, COBS_MAX_ROUNDS + 1):
+        stats["rounds"] = round_number
+        if round_number > 1:
+            stats["rows_resent"] += len(pending)
+        for r in order(pending):
+            ser.write(rows[r])
+            stats["wire_bytes"] += len(rows[r])
+        ser.write(end_packet)
+        stats["wire_bytes"] += len(end_packet)
+
+        # Collect ACK/NACK lines until the ESP32 answers the end packet (or goes quiet).
+        reply = ""
+        while True:
+            reply = read_reply(ser, ("ACK ", "NACK ", "PREVIEW ", "OK ", "ERR ", "MISSING "), COBS_REPLY_TIMEOUT)
+            if reply.startswith("ACK "):
+                pending.discard(int(reply.split()[1]))
+            elif reply.startswith("NACK "):
+                stats["nacks"] += 1
+            elif reply.startswith("PREVIEW "):
+                stats["preview_ms"] = int(reply.split()[2])
+            else:
+                break
+        if reply.startswith("OK "):
+            # "COBS frame <id> drawn in <ms> ms: ..." follows the OK.
+            summary = read_reply(ser, ("COBS frame ",), COBS_REPLY_TIMEOUT).split()
+            if len(summary) > 5:
+                stats["frame_ms"] = int(summary[5])
+            return True, stats
+        if reply.startswith("ERR "):
+            print(f"[COBS] ESP32 rejected the frame: '{reply}'")
+            return False, stats
+        # MISSING or silence: resend whatever has no ACK (possibly nothing but the end packet).
+    return False, stats
+
+def read_reply(ser, prefixes, timeout):
+    """Reads lines until one starts with a prefix in `prefixes` (debug lines are skipped). Returns '' on timeout."""
+    ser.timeout = timeout
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = ser.readline()
+        if not line:
+            break
+        reply = line.decode('utf-8', errors='replace').strip()
+        if reply.startswith(prefixes):
+            return reply
+    return ""
+
+def try_baud_rate(ser, rate, test_bytes=BAUD_TEST_BYTES):
+    """Moves both ends to `rate` and verifies it with a test pattern.
+
+    Returns (ok, host_seconds, device_micros). On failure both ends are back at the
+    rate the link had before.
+    """
+    previous = ser.baudrate
+    ser.reset_input_buffer()
+    ser.write(f"BAUD {rate}\n".encode())
+    if not read_reply(ser, ("BAUD_OK", "BAUD_ERR"), 2).startswith("BAUD_OK"):
+        return False, 0.0, 0
+
+    time.sleep(BAUD_SWITCH_SETTLE)
+    ser.baudrate = rate
+    time.sleep(BAUD_SWITCH_SETTLE)
+    ser.reset_input_buffer()
+
+    # A pattern with every byte value and long runs of neither, so both framing and
+    # bit errors show up in the CRC.
+    pattern = np.random.default_rng(rate).integers(0, 256, test_bytes, dtype=np.uint8).tobytes()
+    start = time.time()
+    ser.write(f"BAUD_TEST {len(pattern)} {zlib.crc32(pattern) & 0xFFFFFFFF}\n".encode() + pattern)
+    reply = read_reply(ser, ("BAUD_PASS", "BAUD_FAIL"), test_bytes * 10 / rate + 2)
+    host_seconds = time.time() - start
+
+    if reply.startswith(f"BAUD_PASS {rate} "):
+        return True, host_seconds, int(reply.split()[2])
+
+    # The ESP32 falls back on its own and confirms with BAUD_FAIL at the old rate.
+    ser.baudrate = previous
+    time.sleep(BAUD_SWITCH_SETTLE)
+    read_reply(ser, ("BAUD_FAIL",), 2)
+    ser.reset_input_buffer()
+    return False, host_seconds, 0
+
+def print_baud_result(rate, ok, host_seconds, device_micros, test_bytes):
+    if not ok:
+        print(f"  {rate:>8} baud: FAILED")
+        return
+    wire_kbs = test_bytes / device_micros * 1e6 / 1024
+    host_kbs = test_bytes / host_seconds / 1024
+    print(f"  {rate:>8} baud: ok, {host_kbs:7.1f} KB/s incl. round trip, {wire_kbs:7.1f} KB/s on the wire "
+          f"({100 * wire_kbs * 1024 * 10 / rate:.0f}% of line rate)")
+
+def negotiate_baud(ser, candidates=BAUD_CANDIDATES):
+    """Settles on the fastest candidate that passes the test pattern. Returns the rate in use."""
+    print(f"[BAUD] Negotiating from {ser.baudrate} baud...")
+    for rate in candidates:
+        if rate <= ser.baudrate:
+            break
+        ok, host_seconds, device_micros = try_baud_rate(ser, rate)
+        print_baud_result(rate, ok, host_seconds, device_micros, BAUD_TEST_BYTES)
+        if ok:
+            return rate
+    print(f"[BAUD] Staying at {ser.baudrate} baud.")
+    return ser.baudrate
+
+def send_frame(ser, frame):
+    """Sends one START_FRAME transfer. Returns the ESP32's OK/ERR line ('' on timeout) and the seconds
+    from the first frame byte to the ack."""
+    ser.reset_input_buffer()
+    ser.write(START_FRAME_COMMAND.encode())
+    time.sleep(0.5)
+    start = time.time()
+    ser.write(frame)
+    return read_reply(ser, ("OK ", "ERR "), ACK_TIMEOUT), time.time() - start
+
+def render_badge(text, size=BADGE_SIZE):
+    """A small text badge to draw over the current image."""
+    badge = Image.new("RGB", size, (16, 16, 16))
+    draw = ImageDraw.Draw(badge)
+    font = ImageFont.load_default()
+    left, top, right, bottom = draw.textbbox((0, 0), text, font=font)
+    draw.text(((size[0] - (right - left)) // 2 - left, (size[1] - (bottom - top)) // 2 - top),
+              text, fill=(255, 255, 255), font=font)
+    return badge
+
+def send_region_serial(ser, pil_image, x, y, frame_id=1):
+    """Draws pil_image at (x, y) with a DRAW_REGION command, leaving the rest of the panel as it is.
+
+    The region goes as raw or RLE, whichever is smaller (selected with SET_FORMAT).
+    Returns the ESP32's OK/ERR line ('' on timeout).
+    """
+    w, h = pil_image.size
+    pixels = to_rgb565(pil_image)
+    raw = pixels.astype('<u2').tobytes()
+    rle = encode_rle(pixels)
+    payload, encoding = (rle, ENC_RLE) if len(rle) < len(raw) else (raw, ENC_RAW)
+
+    ser.write(binary_command(CMD_SET_FORMAT, bytes((encoding,))))
+    if read_reply(ser, ("FORMAT ", "ERR "), 2) != f"FORMAT {encoding}":
+        return "no FORMAT reply"
+    ser.write(binary_command(CMD_DRAW_REGION, struct.pack('<HHHHIII', x, y, w, h, len(payload),
+                                                          zlib.crc32(payload) & 0xFFFFFFFF, frame_id)))
+    ser.write(payload)
+    print(f"[REGION] {w}x{h} at ({x},{y}) as {'RLE' if encoding == ENC_RLE else 'raw'}: {len(payload)} bytes, "
+          f"~{len(payload) * 10 / ser.baudrate * 1000:.0f} ms at {ser.baudrate} baud "
+          f"(a full raw frame takes ~{EXPECTED_SIZE * 10 / ser.baudrate:.1f} s).")
+    return read_reply(ser, ("OK ", "ERR "), ACK_TIMEOUT)
+
 def send_image_serial(raw_data):
-    """Sends the raw binary data to the ESP32 via the serial port."""
+    """Sends the image to the ESP32 as one frame (raw or RLE) and waits for its ack.
+
+    The link is first raised to the fastest rate that passes a test pattern. A frame
+    that fails at a raised rate is resent one rate lower.
+    """
     try:
         print(f"[SERIAL] Connecting to {COM_PORT} at {BAUD_RATE}...")
         
-        ser = serial.Serial(COM_PORT, BAUD_RATE)
-        ser.write_timeout = 1 
+        ser = serial.Serial(COM_PORT, BAUD_RATE, rtscts=USE_HW_FLOW_CONTROL)
+        ser.write_timeout = ACK_TIMEOUT 
         time.sleep(2) 
+        ser.reset_input_buffer()
 
-        # STEP 1: Send the start command
-        print(f"[SERIAL] Sending start command: {START_COMMAND.strip()}")
-        ser.write(START_COMMAND.encode())
-        time.sleep(0.5) 
+        candidates = BAUD_CANDIDATES if NEGOTIATE_BAUD else []
+        for attempt in range(1, MAX_SEND_ATTEMPTS + 1):
+            rate = negotiate_baud(ser, candidates)
 
-        # STEP 2: Send raw image data
-        print(f"[SERIAL] Streaming {len(raw_data)} bytes of image data...")
-        
-        bytes_sent = ser.write(raw_data)
-        
-        ser.close()
+            if SERIAL_TRANSPORT == "cobs":
+                print(f"[SERIAL] Sending {START_COBS_FRAME_COMMAND.strip()} at {rate} baud (attempt {attempt})...")
+                start = time.time()
+                ok, stats = send_frame_cobs(ser, raw_data, frame_id=attempt)
+                elapsed, wire_bytes = time.time() - start, stats["wire_bytes"]
+                print(f"[COBS] {stats['rounds']} round(s), {stats['rows_resent']} row(s) resent, {stats['nacks']} NACK(s).")
+                if stats["preview_ms"] is not None:
+                    print(f"[COBS] Interlaced preview after {stats['preview_ms']} ms, full frame after {stats['frame_ms']} ms.")
+                ack = "OK" if ok else "no complete frame"
+            else:
+                frame = encode_frame(raw_data, frame_id=attempt, baud=rate)
+                print(f"[SERIAL] Sending {START_FRAME_COMMAND.strip()} at {rate} baud (attempt {attempt})...")
+                ack, elapsed = send_frame(ser, frame)
+                ok, wire_bytes = ack.startswith("OK "), len(frame)
 
-        if bytes_sent == EXPECTED_SIZE:
-            print("--- SUCCESS ---")
-            print("Image generated, converted, and transmitted successfully via Stability AI.")
-        else:
-            print(f"--- FAILURE --- (Only sent {bytes_sent} of {EXPECTED_SIZE})")
+            if ok:
+                print("--- SUCCESS ---")
+                print(f"Image generated, converted, and transmitted successfully in {elapsed:.1f} s "
+                      f"({wire_bytes / elapsed / 1024:.1f} KB/s effective at {rate} baud).")
+                break
+            print(f"--- FAILURE --- (ESP32 replied '{ack}' at {rate} baud)")
+            if rate == BAUD_RATE:
+                break
+            # The ESP32 drops to BAUD_RATE after an ERR, or after BAUD_LEASE of silence
+            # if the frame never completed. Follow it and renegotiate one step lower.
+            time.sleep(BAUD_LEASE)
+            ser.baudrate = BAUD_RATE
+            ser.reset_input_buffer()
+            candidates = [r for r in candidates if r < rate]
+
+        ser.close()
 
     except serial.SerialException as e:
         print("--- SERIAL CONNECTION ERROR ---")
@@ -152,7 +521,223 @@ def send_image_serial(raw_data):
     except Exception as e:
         print(f"An unexpected error occurred: {e}")
 
+def benchmark_baud():
+    """Tries every candidate rate and reports effective throughput for each."""
+    ser = serial.Serial(COM_PORT, BAUD_RATE, rtscts=USE_HW_FLOW_CONTROL)
+    time.sleep(2)
+    ser.reset_input_buffer()
+    print(f"[BENCH] {BAUD_BENCH_BYTES}-byte test pattern per rate on {COM_PORT}:")
+    for rate in sorted(BAUD_CANDIDATES + [BAUD_RATE]):
+        ok, host_seconds, device_micros = try_baud_rate(ser, rate, BAUD_BENCH_BYTES)
+        print_baud_result(rate, ok, host_seconds, device_micros, BAUD_BENCH_BYTES)
+        if ok and rate != BAUD_RATE:
+            # Let the lease expire so the next rate is negotiated from BAUD_RATE.
+            time.sleep(BAUD_LEASE + 0.5)
+            ser.baudrate = BAUD_RATE
+            ser.reset_input_buffer()
+    ser.close()
+
+class CobsLoopbackDevice:
+    """Python stand-in for drawCobsFrameFromSerial() behind a pseudo-terminal.
+
+    Bytes from the host are damaged on the way in (flipped, dropped or duplicated
+    with probability `error_rate` each) to model a noisy USB-serial line. `panel`
+    holds the rows on screen: an interlaced row is copied down over the rows of
+    later passes that have not arrived, as the sketch does, and `preview` is the
+    panel as it stood when pass 1 completed.
+    """
+
+    def __init__(self, error_rate, seed=0):
+        self.error_rate = error_rate
+        self.rng = random.Random(seed)
+        self.master, slave = os.openpty()
+        self.port = os.ttyname(slave)
+        self.slave = slave
+        self.rows = {}
+        self.panel = [None] * IMAGE_HEIGHT
+        self.preview = None
+        self.received_bytes = 0  # bytes parsed so far, command line and packet delimiters included
+        self.preview_bytes = 0
+        self.injected = 0
+        threading.Thread(target=self.run, daemon=True).start()
+
+    def damage(self, data):
+        if not self.error_rate:
+            return data
+        out = bytearray()
+        for byte in data:
+            if self.rng.random() < self.error_rate:
+                self.injected += 1
+                kind = self.rng.randrange(3)
+                if kind == 0:
+                    out.append(byte ^ (1 << self.rng.randrange(8)))
+                elif kind == 2:
+                    out += bytes((byte, byte))
+                continue
+            out.append(byte)
+        return bytes(out)
+
+    def packets(self):
+        pending = bytearray()
+        while True:
+            try:
+                chunk = os.read(self.master, 65536)
+            except OSError:
+                return
+            pending += self.damage(chunk)
+            if not self.rows and b'\n' in pending and pending.startswith(START_COBS_FRAME_COMMAND.encode()):
+                del pending[:len(START_COBS_FRAME_COMMAND)]
+                self.received_bytes += len(START_COBS_FRAME_COMMAND)
+            while b'\x00' in pending:
+                end = pending.index(b'\x00')
+                packet = bytes(pending[:end])
+                del pending[:end + 1]
+                self.received_bytes += end + 1
+                yield packet
+
+    def reply(self, text):
+        os.write(self.master, (text + "\n").encode())
+
+    def run(self):
+        header_seen = False
+        interlaced = False
+        preview_sent = False
+        next_row = 0
+        start = time.time()
+        for packet in self.packets():
+            try:
+                body = cobs_decode(packet)
+                ok = len(body) >= 3 and struct.unpack('<H', body[-2:])[0] == crc16(body[:-2])
+            except ValueError:
+                ok = False
+            body = body[:-2] if ok else b''
+            if not header_seen:
+                header_seen = ok and len(body) == struct.calcsize(FRAME_HEADER_FORMAT)
+                if not header_seen:
+                    self.reply("ERR 0 header")
+                    continue
+                interlaced = bool(struct.unpack(FRAME_HEADER_FORMAT, body)[5] & FRAME_FLAG_INTERLACED)
+                start = time.time()
+                continue
+            row = struct.unpack('<H', body[:2])[0] if ok else None
+            if row == COBS_ROW_END and len(body) == 2:
+                missing = IMAGE_HEIGHT - len(self.rows)
+                if missing == 0:
+                    self.reply("OK 1")
+                    self.reply(f"COBS frame 1 drawn in {int((time.time() - start) * 1000)} ms: simulated.")
+                else:
+                    self.reply(f"MISSING {missing}")
+            elif not ok or row >= IMAGE_HEIGHT or len(body) != 2 + IMAGE_WIDTH * 2:
+                self.reply(f"NACK {next_row}")
+            else:
+                span = INTERLACE_SPANS[interlace_pass(row)] if interlaced else 1
+                fill = 1
+                while fill < span and row + fill < IMAGE_HEIGHT and row + fill not in self.rows:
+                    fill += 1
+                self.panel[row:row + fill] = [body[2:]] * fill
+                self.rows[row] = body[2:]
+                if interlaced and not preview_sent and all(r in self.rows for r in range(0, IMAGE_HEIGHT, 8)):
+                    preview_sent = True
+                    self.preview = list(self.panel)
+                    self.preview_bytes = self.received_bytes
+                    self.reply(f"PREVIEW 1 {int((time.time() - start) * 1000)}")
+                self.reply(f"ACK {row}")
+                next_row = row + 1
+
+    def image(self):
+        return b''.join(row or b'' for row in self.panel)
+
+def benchmark_cobs():
+    """Sends a frame through the COBS transport over a pseudo-terminal at several byte error rates."""
+    global COBS_REPLY_TIMEOUT
+    COBS_REPLY_TIMEOUT = 0.3  # a pty answers in microseconds
+    raw_data = np.random.default_rng(1).integers(0, 65536, IMAGE_WIDTH * IMAGE_HEIGHT, dtype=np.uint16).astype('<u2').tobytes()
+    print(f"[BENCH] COBS row transport, {len(raw_data)}-byte frame over a pseudo-terminal:")
+    print(f"  {'error rate':>10} {'errors':>7} {'result':>7} {'rounds':>7} {'resent':>7} {'NACKs':>6} {'wire bytes':>11} {'overhead':>9} {'ms':>7}")
+    for error_rate in (0, 1e-5, 1e-4, 5e-4, 1e-3):
+        device = CobsLoopbackDevice(error_rate)
+        ser = serial.Serial(device.port, BAUD_RATE)
+        start = time.time()
+        ok, stats = send_frame_cobs(ser, raw_data)
+        elapsed = time.time() - start
+        ser.close()
+        intact = ok and device.image() == raw_data
+        print(f"  {error_rate:>10g} {device.injected:>7} {'ok' if intact else 'FAILED':>7} {stats['rounds']:>7} "
+              f"{stats['rows_resent']:>7} {stats['nacks']:>6} {stats['wire_bytes']:>11} "
+              f"{100 * (stats['wire_bytes'] / len(raw_data) - 1):>8.1f}% {elapsed * 1000:>7.0f}")
+        os.close(device.master)
+        os.close(device.slave)
+
+def benchmark_commands():
+    """Measures command round trips with binary PINGs and reads the ESP32's dispatch statistics."""
+    ser = serial.Serial(COM_PORT, BAUD_RATE, rtscts=USE_HW_FLOW_CONTROL)
+    time.sleep(2)
+    ser.reset_input_buffer()
+    rtts = []
+    for seq in range(PING_COUNT):
+        start = time.perf_counter()
+        ser.write(binary_command(CMD_PING, struct.pack('<I', seq)))
+        if read_reply(ser, (f"PONG {seq} ",), 1):
+            rtts.append((time.perf_counter() - start) * 1000)
+    stats = query_stats(ser)
+    ser.close()
+
+    print(f"[BENCH] {len(rtts)}/{PING_COUNT} PINGs answered at {BAUD_RATE} baud.")
+    if rtts:
+        rtts.sort()
+        print(f"  round trip ms: min {rtts[0]:.2f}, median {rtts[len(rtts) // 2]:.2f}, "
+              f"p99 {rtts[int(len(rtts) * 0.99)]:.2f}, max {rtts[-1]:.2f}")
+    print(f"  ESP32 dispatch us: avg {stats.get('dispatch_us_avg')}, max {stats.get('dispatch_us_max')}; "
+          f"longest gap between parser polls {stats.get('poll_gap_us_max')} us; "
+          f"{stats.get('rejected')} rejected command(s).")
+
+def benchmark_interlace():
+    """Time to first preview and to full frame: an interlaced COBS transfer vs. a plain raw START_FRAME.
+
+    The interlaced byte counts are measured over a pseudo-terminal stand-in, which
+    fills the gaps as the sketch does; the preview must cover every row.
+    """
+    raw_data = convert_to_rgb565_raw(Image.open(os.path.join(os.path.dirname(os.path.abspath(__file__)), "summary.jpg")))
+    plain_bytes = len(START_FRAME_COMMAND) + len(frame_header(ENC_RAW, raw_data, 1)) + len(raw_data)
+
+    global COBS_REPLY_TIMEOUT
+    COBS_REPLY_TIMEOUT = 0.3
+    device = CobsLoopbackDevice(0)
+    ser = serial.Serial(device.port, BAUD_RATE)
+    ok, stats = send_frame_cobs(ser, raw_data, interlaced=True)
+    ser.close()
+    os.close(device.master)
+    os.close(device.slave)
+    preview_bytes, full_bytes = device.preview_bytes, device.received_bytes
+    covered = sum(row is not None for row in device.preview or [])
+
+    print(f"[BENCH] Interlaced COBS transfer: first preview after {preview_bytes} of {full_bytes} bytes "
+          f"({100 * preview_bytes / full_bytes:.1f}%), covering {covered}/{IMAGE_HEIGHT} rows; "
+          f"a plain raw frame is {plain_bytes} bytes.")
+    print(f"  pty loopback {'ok' if ok and device.image() == raw_data else 'FAILED'}: "
+          f"preview at {stats['preview_ms']} ms, full frame at {stats['frame_ms']} ms.")
+    print(f"  {'baud':>8} {'plain raw full s':>17} {'interlaced preview s':>21} {'interlaced full s':>18}")
+    for rate in sorted(set(BAUD_CANDIDATES + [BAUD_RATE])):
+        print(f"  {rate:>8} {plain_bytes * 10 / rate:>17.2f} {preview_bytes * 10 / rate:>21.2f} {full_bytes * 10 / rate:>18.2f}")
+
+BENCHMARKS = {"baud": benchmark_baud, "cobs": benchmark_cobs, "commands": benchmark_commands,
+              "interlace": benchmark_interlace}
+
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate an image and stream it to the ESP32 over USB serial.")
+    parser.add_argument("--bench", choices=sorted(BENCHMARKS), help="run a benchmark instead of streaming")
+    parser.add_argument("--badge", metavar="TEXT", help="draw TEXT as a badge in the top-right corner and exit")
+    args = parser.parse_args()
+    if args.bench:
+        BENCHMARKS[args.bench]()
+        sys.exit(0)
+    if args.badge:
+        ser = serial.Serial(COM_PORT, BAUD_RATE, rtscts=USE_HW_FLOW_CONTROL)
+        time.sleep(2)
+        ser.reset_input_buffer()
+        print(send_region_serial(ser, render_badge(args.badge), IMAGE_WIDTH - BADGE_SIZE[0] - 4, 4) or "no reply")
+        ser.close()
+        sys.exit(0)
     
     # 1. Generate Image using Stability AI
     pil_image = generate_image_from_prompt(PROMPT, STABILITY_API_KEY)
@@ -1,4 +1,5 @@
 #include <TFT_eSPI.h>
+#include "rom/crc.h"
 
 TFT_eSPI tft = TFT_eSPI();
 
@@ -13,10 +14,124 @@ const size_t EXPECTED_IMAGE_SIZE = 320 * 170 * 2; // 108800 bytes
 const size_t LINE_BYTE_COUNT = IMAGE_WIDTH * 2; // 640 bytes per line
 
 // Buffer for one line of image data (640 bytes)
-uint8_t lineBuf[LINE_BYTE_COUNT]; 
+uint16_t lineBuf[IMAGE_WIDTH]; 
 
 #define STABLE_BAUD_RATE 115200 
 const char* START_COMMAND = "START_IMAGE_TRANSFER";
+const char* START_FRAME_COMMAND = "START_FRAME";  // followed by one binary frame (see FrameHeader)
+const char* BAUD_COMMAND = "BAUD ";               // "BAUD <rate>", then a verified test pattern at that rate
+const char* START_COBS_FRAME_COMMAND = "START_COBS_FRAME";  // followed by COBS packets (see drawCobsFrameFromSerial)
+
+// --- BAUD NEGOTIATION ---
+// The link always starts at STABLE_BAUD_RATE. The host asks for a faster rate, both
+// ends switch, and the rate is kept only if a CRC-checked test pattern arrives intact.
+// 2000000 needs a CH340/CH9102 USB bridge; CP2102 boards top out at 921600.
+const uint32_t SUPPORTED_BAUD_RATES[] = { 2000000, 1500000, 921600, 460800, 230400, STABLE_BAUD_RATE };
+#define BAUD_SWITCH_SETTLE_MS 20      // pause after switching so the UART and the host settle
+#define BAUD_LEASE_MS         3000    // a raised rate drops back to STABLE_BAUD_RATE after this much silence
+#define BAUD_TEST_MAX_BYTES   65536
+#define SERIAL_RX_BUFFER_SIZE 4096    // room for ~20 ms of data at 2 Mbaud while a row is pushed
+
+// Optional RTS/CTS. Most dev boards do not route these lines to the USB bridge,
+// so this is for an external USB-UART adapter wired to the pins below. The rates
+// the host settles on (and its --bench baud figures) are without it.
+#define USE_HW_FLOW_CONTROL 0
+#define UART_RTS_PIN 22
+#define UART_CTS_PIN 19
+#define UART_RTS_THRESHOLD 64  // bytes in the 128-byte hardware RX FIFO before RTS is deasserted
+
+uint32_t currentBaud = STABLE_BAUD_RATE;
+uint32_t lastSerialActivity = 0;
+
+// --- COBS ROW TRANSPORT ---
+// Each packet is COBS-encoded and terminated by 0x00, so a dropped or corrupted
+// byte costs one row instead of shifting every later pixel.
+#define COBS_ROW_END         0xFFFF   // row index of the closing packet
+#define COBS_IDLE_TIMEOUT_MS 3000     // give up when no good packet arrives for this long
+const size_t COBS_MAX_PACKET = 2 + LINE_BYTE_COUNT + 2;  // row index + pixels + CRC16
+uint8_t cobsBuf[COBS_MAX_PACKET + COBS_MAX_PACKET / 254 + 2] __attribute__((aligned(4)));
+
+// --- FRAME PROTOCOL (same header as the WiFi sketch, port 8080) ---
+#define FRAME_MAGIC            "IMGF"
+#define FRAME_PROTOCOL_VERSION 1
+#define PIXFMT_RGB565 0  // 2 bytes per pixel, little-endian
+#define ENC_RAW 0        // h rows of w pixels, top to bottom
+#define ENC_RLE 2        // PackBits on 16-bit pixels, runs may cross rows (see drawRleRows)
+#define FRAME_FLAG_INTERLACED 0x0002  // START_COBS_FRAME only: rows arrive in interlace passes
+
+struct __attribute__((packed)) FrameHeader {
+  char     magic[4];
+  uint8_t  version;
+  uint8_t  format;
+  uint8_t  encoding;
+  uint8_t  reserved0;
+  uint16_t flags;
+  uint16_t reserved1;
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+  uint32_t payloadLen;
+  uint32_t frameId;
+  uint32_t crc32;       // CRC-32 of the payload
+};
+static_assert(sizeof(FrameHeader) == 32, "FrameHeader must be 32 bytes on the wire");
+
+// Reads exactly the payload announced by the header and keeps a running CRC.
+struct PayloadReader {
+  uint32_t remaining;
+  uint32_t crc;
+
+  bool read(void* dst, size_t n) {
+    if (n > remaining) return false;
+    size_t got = Serial.readBytes((char*)dst, n);
+    crc = crc32_le(crc, (const uint8_t*)dst, got);
+    remaining -= got;
+    return got == n;
+  }
+};
+
+// --- COMMAND PARSER ---
+// loop() feeds the parser whatever bytes have arrived, at most CMD_MAX_BYTES_PER_POLL
+// per call, and never waits for more. Text commands end in '\n'. Binary commands are
+//   0xA5 | opcode | len | payload[len] | CRC16 (over opcode, len and payload)
+// and 0xA5 cannot start a text command. Replies are text lines, like everything else.
+#define CMD_BUFFER_SIZE          64
+#define CMD_MAX_BYTES_PER_POLL   64
+#define CMD_INTERBYTE_TIMEOUT_MS 500    // a half-received command is dropped after this much silence
+#define CMD_BINARY_SYNC          0xA5
+#define CMD_PING        0x01  // payload: seq (uint32)                      -> "PONG <seq> <dispatch_us>"
+#define CMD_STATS       0x02  // no payload                                 -> "STATS key=value ..."
+#define CMD_DRAW_REGION 0x03  // payload: x, y, w, h (uint16), payload_len, crc32, frame_id (uint32),
+                              // then payload_len bytes in the current format -> "OK <id>" / "ERR <id> <reason>"
+#define CMD_SET_FORMAT  0x04  // payload: encoding (uint8, ENC_RAW or ENC_RLE) -> "FORMAT <encoding>"
+
+enum CommandState : uint8_t { CMD_IDLE, CMD_TEXT, CMD_BINARY };
+
+struct CommandParser {
+  CommandState state;
+  uint8_t buf[CMD_BUFFER_SIZE];
+  size_t len;
+  bool overflow;             // text line longer than the buffer: discarded up to its '\n'
+  uint32_t firstByteMicros;  // when the current command's first byte was read
+  uint32_t lastByteMillis;
+};
+CommandParser parser;
+
+struct SerialStats {
+  uint32_t textCommands;
+  uint32_t binaryCommands;
+  uint32_t rejectedCommands;  // bad CRC, overflow or interbyte timeout
+  uint32_t framesOk;
+  uint32_t framesFailed;
+  uint32_t lastDispatchMicros;  // first byte of a command to its handler being called
+  uint32_t maxDispatchMicros;
+  uint64_t totalDispatchMicros;
+  uint32_t maxPollGapMicros;    // longest stretch between parser polls outside handlers
+};
+SerialStats serialStats;
+uint32_t lastPollMicros = 0;
+uint8_t regionEncoding = ENC_RAW;  // set by CMD_SET_FORMAT, used by CMD_DRAW_REGION
 
 // *** REMOVED: The manual swap_bytes function ***
 
@@ -41,7 +156,7 @@ void drawImageFromSerial() {
     
     // CRITICAL FIX: Push the colors directly without manual byte swap.
     // The 'true' flag in pushColors tells the library to handle any necessary byte swapping.
-    tft.pushColors((uint16_t*)lineBuf, IMAGE_WIDTH, true); 
+    tft.pushColors(lineBuf, IMAGE_WIDTH, true); 
     bytesReadTotal += bytesRead;
   }
   
@@ -53,9 +168,493 @@ void drawImageFromSerial() {
   }
 }
 
+// Returns NULL if the header describes a frame we can draw, else the reason.
+const char* validateFrameHeader(const FrameHeader& hdr) {
+  if (memcmp(hdr.magic, FRAME_MAGIC, 4) != 0) return "magic";
+  if (hdr.version != FRAME_PROTOCOL_VERSION) return "version";
+  if (hdr.reserved0 != 0 || hdr.reserved1 != 0 || (hdr.flags & ~FRAME_FLAG_INTERLACED) != 0) return "reserved";
+  if (hdr.format != PIXFMT_RGB565) return "format";
+  if (hdr.w == 0 || hdr.h == 0) return "empty";
+  if ((uint32_t)hdr.x + hdr.w > IMAGE_WIDTH || (uint32_t)hdr.y + hdr.h > IMAGE_HEIGHT) return "geometry";
+  switch (hdr.encoding) {
+    case ENC_RAW:
+      if (hdr.payloadLen != (uint32_t)hdr.w * hdr.h * 2) return "length";
+      break;
+    case ENC_RLE:
+      if (hdr.payloadLen == 0 || hdr.payloadLen > (uint32_t)hdr.w * hdr.h * 2 + ((uint32_t)hdr.w * hdr.h + 127) / 128) return "length";
+      break;
+    default:
+      return "encoding";
+  }
+  return NULL;
+}
+
+const char* drawRawRows(PayloadReader& reader, const FrameHeader& hdr) {
+  for (int y = 0; y < hdr.h; y++) {
+    if (!reader.read(lineBuf, (size_t)hdr.w * 2)) return "short";
+    tft.pushColors(lineBuf, hdr.w, true);
+  }
+  return NULL;
+}
+
+// Decodes the RLE stream straight into lineBuf, one row at a time. Control byte c:
+//   0x00-0x7F  literal: c+1 pixels follow
+//   0x80-0xFF  run: the next pixel is repeated c-0x80+2 times
+const char* drawRleRows(PayloadReader& reader, const FrameHeader& hdr) {
+  const uint32_t totalPixels = (uint32_t)hdr.w * hdr.h;
+  uint32_t produced = 0;
+  size_t col = 0;
+
+  while (produced < totalPixels) {
+    uint8_t ctrl;
+    uint16_t runPixel = 0;
+    if (!reader.read(&ctrl, 1)) return "short";
+    bool isRun = ctrl >= 0x80;
+    uint32_t count = isRun ? (ctrl - 0x80 + 2) : (ctrl + 1);
+    if (isRun && !reader.read(&runPixel, 2)) return "short";
+    if (produced + count > totalPixels) return "rle";
+
+    while (count > 0) {
+      size_t n = min((size_t)count, hdr.w - col);
+      if (isRun) {
+        for (size_t i = 0; i < n; i++) lineBuf[col + i] = runPixel;
+      } else if (!reader.read(lineBuf + col, n * 2)) {
+        return "short";
+      }
+      col += n;
+      count -= n;
+      produced += n;
+      if (col == hdr.w) {
+        tft.pushColors(lineBuf, hdr.w, true);
+        col = 0;
+      }
+    }
+  }
+  return reader.remaining == 0 ? NULL : "length";
+}
+
+bool isSupportedBaud(uint32_t rate) {
+  for (uint32_t supported : SUPPORTED_BAUD_RATES) {
+    if (supported == rate) return true;
+  }
+  return false;
+}
+
+void switchBaud(uint32_t rate) {
+  Serial.flush();  // let the last reply leave at the old rate
+  Serial.updateBaudRate(rate);
+  currentBaud = rate;
+  delay(BAUD_SWITCH_SETTLE_MS);
+  while (Serial.available()) Serial.read();  // drop bytes garbled by the switch
+}
+
+// Expects "BAUD_TEST <len> <crc32>" and then <len> pattern bytes at the new rate.
+// Returns the microseconds the pattern took on the wire, or 0 if it did not arrive intact.
+uint32_t receiveBaudTestPattern() {
+  char line[48];
+  size_t n = Serial.readBytesUntil('\n', line, sizeof(line) - 1);
+  line[n] = '\0';
+  unsigned long len = 0, expectedCrc = 0;
+  if (sscanf(line, "BAUD_TEST %lu %lu", &len, &expectedCrc) != 2) return 0;
+  if (len == 0 || len > BAUD_TEST_MAX_BYTES) return 0;
+
+  uint32_t crc = 0;
+  uint32_t start = micros();
+  while (len > 0) {
+    size_t n = min((size_t)len, sizeof(lineBuf));
+    if (Serial.readBytes((char*)lineBuf, n) != n) return 0;
+    crc = crc32_le(crc, (const uint8_t*)lineBuf, n);
+    len -= n;
+  }
+  uint32_t elapsed = micros() - start;
+  return crc == expectedCrc ? max(elapsed, (uint32_t)1) : 0;
+}
+
+// Handles "BAUD <rate>". The reply to the request goes out at the old rate and the
+// verdict at the new one; on failure the device is back at the old rate and says so there.
+void negotiateBaud(uint32_t rate) {
+  if (!isSupportedBaud(rate)) {
+    Serial.printf("BAUD_ERR %lu unsupported\n", (unsigned long)rate);
+    return;
+  }
+  uint32_t previous = currentBaud;
+  Serial.printf("BAUD_OK %lu\n", (unsigned long)rate);
+  switchBaud(rate);
+
+  uint32_t wireMicros = receiveBaudTestPattern();
+  if (wireMicros) {
+    Serial.printf("BAUD_PASS %lu %lu\n", (unsigned long)rate, (unsigned long)wireMicros);
+  } else {
+    switchBaud(previous);
+    Serial.printf("BAUD_FAIL %lu\n", (unsigned long)rate);
+  }
+  tft.fillRect(10, 30, 200, 16, TFT_BLACK);
+  tft.drawString(String("Baud Rate: ") + String((unsigned long)currentBaud), 10, 30, 2);
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), the same as Python's binascii.crc_hqx(data, 0xFFFF).
+uint16_t crc16Ccitt(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// Decodes a COBS packet in place. Returns the decoded length, or 0 if it is malformed.
+size_t cobsDecode(uint8_t* buf, size_t len) {
+  size_t in = 0, out = 0;
+  while (in < len) {
+    uint8_t code = buf[in++];
+    if (code == 0) return 0;
+    for (uint8_t i = 1; i < code; i++) {
+      if (in >= len) return 0;
+      buf[out++] = buf[in++];
+    }
+    if (code < 0xFF && in < len) buf[out++] = 0;
+  }
+  return out;
+}
+
+// Reads one 0x00-terminated packet into cobsBuf and checks its trailing CRC16.
+// Returns the decoded length without the CRC, 0 for a damaged packet, -1 if nothing arrived.
+int readCobsPacket() {
+  size_t n = Serial.readBytesUntil(0, (char*)cobsBuf, sizeof(cobsBuf));
+  if (n == 0) return Serial.available() ? 0 : -1;
+  size_t len = cobsDecode(cobsBuf, n);
+  if (len < 3) return 0;
+  uint16_t crc;
+  memcpy(&crc, cobsBuf + len - 2, 2);
+  return crc == crc16Ccitt(cobsBuf, len - 2) ? (int)(len - 2) : 0;
+}
+
+// Interlaced frames arrive in four passes, Adam7-style on rows:
+//   pass 1: every 8th row from 0    pass 2: every 8th row from 4
+//   pass 3: every 4th row from 2    pass 4: the odd rows
+// A row stands in for the rows below it that a later pass will send (span), so a
+// blocky preview covers the whole frame after pass 1, about 1/8 of the bytes.
+uint16_t interlaceSpan(uint16_t row) {
+  if (row % 8 == 0) return 8;
+  if (row % 4 == 0) return 4;
+  if (row % 2 == 0) return 2;
+  return 1;
+}
+
+// The row the host sends after `row` in interlaced order (h if it was the last).
+uint16_t nextInterlacedRow(uint16_t row, uint16_t h) {
+  uint16_t span = interlaceSpan(row);
+  uint16_t step = (span == 8) ? 8 : span * 2;
+  if (row + step < h) return row + step;
+  if (span == 1) return h;
+  uint16_t first = span / 2;  // first row of the next pass
+  return first < h ? first : nextInterlacedRow(first, h);
+}
+
+bool rowReceived(const uint8_t* received, uint16_t row) {
+  return received[row / 8] & (1 << (row % 8));
+}
+
+// Handles START_COBS_FRAME, a raw RGB565 frame sent as one COBS packet per row:
+//   header packet  FrameHeader + CRC16 (crc32 is not checked, rows carry their own CRC)
+//   row packet     row index (uint16) + w pixels + CRC16, answered "ACK <row>" or "NACK <row>"
+//   end packet     row index 0xFFFF + CRC16, answered "OK <id>" once every row is in,
+//                  else "MISSING <count>" so the host resends the rows it has no ACK for
+// Rows may arrive in any order and repeats are harmless. A damaged packet's row index
+// cannot be trusted, so its NACK names the row that most likely followed the last good one.
+// With FRAME_FLAG_INTERLACED each row is also copied down over the rows of later passes
+// that have not arrived, and "PREVIEW <id> <ms>" is sent once pass 1 is complete.
+void drawCobsFrameFromSerial() {
+  FrameHeader hdr;
+  if (readCobsPacket() != (int)sizeof(FrameHeader)) {
+    Serial.println("ERR 0 header");
+    return;
+  }
+  memcpy(&hdr, cobsBuf, sizeof(hdr));
+  const char* error = validateFrameHeader(hdr);
+  if (!error && hdr.encoding != ENC_RAW) error = "encoding";
+  if (error) {
+    Serial.printf("ERR %lu %s\n", (unsigned long)hdr.frameId, error);
+    return;
+  }
+
+  const int rowPacketLen = 2 + hdr.w * 2;
+  const bool interlaced = hdr.flags & FRAME_FLAG_INTERLACED;
+  const uint16_t previewRows = (hdr.h + 7) / 8;
+  uint8_t received[(IMAGE_HEIGHT + 7) / 8] = { 0 };
+  uint16_t rowsReceived = 0, nextRow = 0, pass1Received = 0;
+  uint32_t nacks = 0, duplicates = 0;
+  uint32_t start = millis(), lastGood = start;
+
+  while (millis() - lastGood < COBS_IDLE_TIMEOUT_MS) {
+    int len = readCobsPacket();
+    if (len < 0) continue;
+    uint16_t row = COBS_ROW_END;
+    if (len >= 2) memcpy(&row, cobsBuf, 2);
+
+    if (len == 2 && row == COBS_ROW_END) {
+      lastGood = millis();
+      if (rowsReceived == hdr.h) {
+        Serial.printf("OK %lu\n", (unsigned long)hdr.frameId);
+        serialStats.framesOk++;
+        Serial.printf("COBS frame %lu drawn in %lu ms: %lu NACKs, %lu repeated rows.\n",
+                      (unsigned long)hdr.frameId, (unsigned long)(millis() - start),
+                      (unsigned long)nacks, (unsigned long)duplicates);
+        return;
+      }
+      Serial.printf("MISSING %u\n", hdr.h - rowsReceived);
+      continue;
+    }
+    if (len != rowPacketLen || row >= hdr.h) {
+      nacks++;
+      Serial.printf("NACK %u\n", nextRow);
+      continue;
+    }
+
+    uint16_t fill = 1;
+    if (interlaced) {
+      uint16_t span = interlaceSpan(row);
+      while (fill < span && row + fill < hdr.h && !rowReceived(received, row + fill)) fill++;
+    }
+    tft.setAddrWindow(hdr.x, hdr.y + row, hdr.w, fill);
+    for (uint16_t i = 0; i < fill; i++) tft.pushColors((uint16_t*)(cobsBuf + 2), hdr.w, true);
+
+    if (rowReceived(received, row)) {
+      duplicates++;
+    } else {
+      received[row / 8] |= 1 << (row % 8);
+      rowsReceived++;
+      if (interlaced && row % 8 == 0 && ++pass1Received == previewRows) {
+        Serial.printf("PREVIEW %lu %lu\n", (unsigned long)hdr.frameId, (unsigned long)(millis() - start));
+      }
+    }
+    Serial.printf("ACK %u\n", row);
+    nextRow = interlaced ? nextInterlacedRow(row, hdr.h) : row + 1;
+    lastGood = millis();
+  }
+
+  // The rows that did arrive stay on the panel.
+  Serial.printf("ERR %lu timeout\n", (unsigned long)hdr.frameId);
+  serialStats.framesFailed++;
+  if (currentBaud != STABLE_BAUD_RATE) switchBaud(STABLE_BAUD_RATE);
+}
+
+// Draws the payload that follows a validated header and answers
+// "OK <id>" or "ERR <id> <reason>" so the host can move on or resend.
+void drawFramePayload(const FrameHeader& hdr) {
+  const char* error = validateFrameHeader(hdr);
+  if (!error && (hdr.flags & FRAME_FLAG_INTERLACED)) error = "flags";  // rows are pushed in order here
+  if (error) {
+    Serial.printf("ERR %lu %s\n", (unsigned long)hdr.frameId, error);
+    serialStats.framesFailed++;
+    return;
+  }
+
+  uint32_t start = millis();
+  PayloadReader reader = { hdr.payloadLen, 0 };
+  tft.setAddrWindow(hdr.x, hdr.y, hdr.w, hdr.h);
+  error = (hdr.encoding == ENC_RLE) ? drawRleRows(reader, hdr) : drawRawRows(reader, hdr);
+
+  if (!error && reader.crc != hdr.crc32) error = "crc";
+  if (error) {
+    tft.fillScreen(TFT_RED);
+    Serial.printf("ERR %lu %s\n", (unsigned long)hdr.frameId, error);
+    serialStats.framesFailed++;
+    // A raised rate that corrupts frames is not trusted again until renegotiated.
+    if (currentBaud != STABLE_BAUD_RATE) switchBaud(STABLE_BAUD_RATE);
+    return;
+  }
+  Serial.printf("OK %lu\n", (unsigned long)hdr.frameId);
+  serialStats.framesOk++;
+  Serial.printf("Frame %lu drawn: %lu payload bytes for %ux%u pixels in %lu ms.\n",
+                (unsigned long)hdr.frameId, (unsigned long)hdr.payloadLen, hdr.w, hdr.h,
+                (unsigned long)(millis() - start));
+}
+
+// Handles START_FRAME: a 32-byte header then the payload.
+void drawFrameFromSerial() {
+  FrameHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  if (Serial.readBytes((char*)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+    Serial.println("ERR 0 header");
+    serialStats.framesFailed++;
+    return;
+  }
+  drawFramePayload(hdr);
+}
+
+// CMD_DRAW_REGION: the same as START_FRAME, with the header fields taken from a
+// 20-byte binary command and the encoding from CMD_SET_FORMAT.
+void drawRegionFromCommand(const uint8_t* payload) {
+  FrameHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, FRAME_MAGIC, 4);
+  hdr.version = FRAME_PROTOCOL_VERSION;
+  hdr.format = PIXFMT_RGB565;
+  hdr.encoding = regionEncoding;
+  memcpy(&hdr.x, payload, 8);
+  memcpy(&hdr.payloadLen, payload + 8, 4);
+  memcpy(&hdr.crc32, payload + 12, 4);
+  memcpy(&hdr.frameId, payload + 16, 4);
+  drawFramePayload(hdr);
+}
+
+void printSerialStats() {
+  uint32_t commands = serialStats.textCommands + serialStats.binaryCommands;
+  Serial.printf("STATS text=%lu binary=%lu rejected=%lu frames_ok=%lu frames_failed=%lu "
+                "dispatch_us_last=%lu dispatch_us_avg=%lu dispatch_us_max=%lu poll_gap_us_max=%lu baud=%lu\n",
+                (unsigned long)serialStats.textCommands, (unsigned long)serialStats.binaryCommands,
+                (unsigned long)serialStats.rejectedCommands, (unsigned long)serialStats.framesOk,
+                (unsigned long)serialStats.framesFailed, (unsigned long)serialStats.lastDispatchMicros,
+                (unsigned long)(commands ? serialStats.totalDispatchMicros / commands : 0),
+                (unsigned long)serialStats.maxDispatchMicros, (unsigned long)serialStats.maxPollGapMicros,
+                (unsigned long)currentBaud);
+}
+
+void dispatchTextCommand(const char* command) {
+  serialStats.textCommands++;
+  if (strcmp(command, START_COMMAND) == 0) {
+    drawImageFromSerial();
+    //tft.drawString("Draw Complete!", 10, 50, 2);
+  } else if (strcmp(command, START_FRAME_COMMAND) == 0) {
+    drawFrameFromSerial();
+  } else if (strcmp(command, START_COBS_FRAME_COMMAND) == 0) {
+    drawCobsFrameFromSerial();
+  } else if (strncmp(command, BAUD_COMMAND, strlen(BAUD_COMMAND)) == 0) {
+    negotiateBaud(strtoul(command + strlen(BAUD_COMMAND), NULL, 10));
+  } else {
+    Serial.printf("Received unknown command: %s\n", command);
+  }
+}
+
+void dispatchBinaryCommand(uint8_t opcode, const uint8_t* payload, uint8_t len) {
+  serialStats.binaryCommands++;
+  switch (opcode) {
+    case CMD_PING:
+      if (len != 4) break;
+      uint32_t seq;
+      memcpy(&seq, payload, 4);
+      Serial.printf("PONG %lu %lu\n", (unsigned long)seq, (unsigned long)serialStats.lastDispatchMicros);
+      return;
+    case CMD_STATS:
+      printSerialStats();
+      return;
+    case CMD_DRAW_REGION:
+      if (len != 20) break;
+      drawRegionFromCommand(payload);
+      return;
+    case CMD_SET_FORMAT:
+      if (len != 1 || (payload[0] != ENC_RAW && payload[0] != ENC_RLE)) break;
+      regionEncoding = payload[0];
+      Serial.printf("FORMAT %u\n", regionEncoding);
+      return;
+  }
+  serialStats.rejectedCommands++;
+  Serial.printf("ERR 0 command %u\n", opcode);
+}
+
+void resetParser() {
+  parser.state = CMD_IDLE;
+  parser.len = 0;
+  parser.overflow = false;
+}
+
+// Consumes one byte. Returns true once buf holds a complete command, which the
+// caller must dispatch before feeding more bytes.
+bool feedCommandByte(uint8_t c) {
+  if (parser.state == CMD_IDLE) {
+    if (c == '\r' || c == '\n') return false;
+    parser.state = (c == CMD_BINARY_SYNC) ? CMD_BINARY : CMD_TEXT;
+    parser.firstByteMicros = micros();
+    if (parser.state == CMD_BINARY) return false;
+  }
+
+  if (parser.state == CMD_TEXT) {
+    if (c == '\r') return false;
+    if (c == '\n') {
+      if (!parser.overflow) return true;
+      serialStats.rejectedCommands++;
+      Serial.println("ERR 0 command too long");
+      resetParser();
+      return false;
+    }
+    if (parser.len < CMD_BUFFER_SIZE - 1) parser.buf[parser.len++] = c;
+    else parser.overflow = true;
+    return false;
+  }
+
+  // CMD_BINARY: opcode, len, payload, CRC16
+  parser.buf[parser.len++] = c;
+  if (parser.len == 2 && parser.buf[1] > CMD_BUFFER_SIZE - 4) {
+    serialStats.rejectedCommands++;
+    Serial.println("ERR 0 command too long");
+    resetParser();
+    return false;
+  }
+  return parser.len >= 2 && parser.len == (size_t)parser.buf[1] + 4;
+}
+
+void dispatchParsedCommand() {
+  uint32_t dispatch = micros() - parser.firstByteMicros;
+  serialStats.lastDispatchMicros = dispatch;
+  serialStats.totalDispatchMicros += dispatch;
+  if (dispatch > serialStats.maxDispatchMicros) serialStats.maxDispatchMicros = dispatch;
+
+  if (parser.state == CMD_TEXT) {
+    // Trimmed at both ends, as String::trim() did for the old readStringUntil() parser.
+    size_t end = parser.len;
+    while (end > 0 && isspace(parser.buf[end - 1])) end--;
+    parser.buf[end] = '\0';
+    char* command = (char*)parser.buf;
+    while (isspace((uint8_t)*command)) command++;
+    dispatchTextCommand(command);
+  } else {
+    uint8_t len = parser.buf[1];
+    uint16_t crc;
+    memcpy(&crc, parser.buf + 2 + len, 2);
+    if (crc == crc16Ccitt(parser.buf, 2 + len)) {
+      dispatchBinaryCommand(parser.buf[0], parser.buf + 2, len);
+    } else {
+      serialStats.rejectedCommands++;
+      Serial.println("ERR 0 command crc");
+    }
+  }
+  resetParser();
+}
+
+// Called from loop(): consumes what has arrived and returns without waiting.
+// A dispatched command may read its own payload straight from Serial, so
+// parsing stops right after the command that triggered it.
+void pollCommands() {
+  uint32_t now = micros();
+  if (lastPollMicros && now - lastPollMicros > serialStats.maxPollGapMicros) {
+    serialStats.maxPollGapMicros = now - lastPollMicros;
+  }
+
+  if (parser.state != CMD_IDLE && millis() - parser.lastByteMillis > CMD_INTERBYTE_TIMEOUT_MS) {
+    serialStats.rejectedCommands++;
+    resetParser();
+  }
+
+  for (int budget = CMD_MAX_BYTES_PER_POLL; budget > 0 && Serial.available(); budget--) {
+    parser.lastByteMillis = lastSerialActivity = millis();
+    if (feedCommandByte((uint8_t)Serial.read())) {
+      dispatchParsedCommand();
+      lastSerialActivity = millis();
+      break;
+    }
+  }
+  lastPollMicros = micros();
+}
+
 void setup() {
+  Serial.setRxBufferSize(SERIAL_RX_BUFFER_SIZE);  // must precede begin()
   Serial.begin(STABLE_BAUD_RATE); 
   Serial.setTimeout(1000); 
+#if USE_HW_FLOW_CONTROL
+  Serial.setPins(-1, -1, UART_CTS_PIN, UART_RTS_PIN);
+  Serial.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS, UART_RTS_THRESHOLD);
+#endif
 
   // --- DISPLAY INITIALIZATION ---
   tft.init();
@@ -71,15 +670,12 @@ void setup() {
 }
 
 void loop() {
-  if (Serial.available()) {
-    String command = Serial.readStringUntil('\n'); 
-    command.trim(); 
+  pollCommands();
 
-    if (command.equals(START_COMMAND)) {
-      drawImageFromSerial();
-      //tft.drawString("Draw Complete!", 10, 50, 2);
-    } else {
-      Serial.printf("Received unknown command: %s\n", command.c_str());
-    }
+  if (parser.state == CMD_IDLE && currentBaud != STABLE_BAUD_RATE && millis() - lastSerialActivity > BAUD_LEASE_MS) {
+    // The host has gone quiet (or restarted at the default rate): fall back.
+    switchBaud(STABLE_BAUD_RATE);
+    tft.fillRect(10, 30, 200, 16, TFT_BLACK);
+    tft.drawString("Baud Rate: 115200", 10, 30, 2);
   }
 }
\ No newline at end of file
@@ -1,12 +1,128 @@
 import serial
 import time
 import os
+import struct
+import zlib
+import numpy as np
 
 # --- Configuration ---
 COM_PORT = 'COM17' 
 BAUD_RATE = 115200 
 FILE_PATH = "myimage.raw"
-START_COMMAND = "START_IMAGE_TRANSFER\n" # Command followed by newline
+START_FRAME_COMMAND = "START_FRAME\n"  # followed by a framed image, answered with OK/ERR
+ACK_TIMEOUT = 30 # seconds; a raw frame alone takes ~9.5 s at 115200 baud
+MAX_SEND_ATTEMPTS = 3
+
+# --- LCD Image Dimensions ---
+IMAGE_WIDTH = 320
+IMAGE_HEIGHT = 170
+
+# --- Frame Protocol (must match FrameHeader in DIYMORE_LCD_USB.ino) ---
+# The CRC-32 in the header lets the ESP32 reject a frame corrupted at a raised rate.
+FRAME_MAGIC = b'IMGF'
+FRAME_PROTOCOL_VERSION = 1
+FRAME_HEADER_FORMAT = '<4sBBBBHHHHHHIII'
+PIXFMT_RGB565 = 0
+ENC_RAW = 0
+
+# --- Baud Negotiation (must match SUPPORTED_BAUD_RATES in DIYMORE_LCD_USB.ino) ---
+# The link opens at BAUD_RATE; each candidate is tried fastest first and kept only if
+# the ESP32 receives a CRC-checked test pattern intact at that rate.
+NEGOTIATE_BAUD = True
+BAUD_CANDIDATES = [2000000, 1500000, 921600, 460800, 230400]
+BAUD_TEST_BYTES = 4096
+BAUD_SWITCH_SETTLE = 0.05 # seconds
+BAUD_LEASE = 3 # seconds of silence after which the ESP32 is back at BAUD_RATE
+# RTS/CTS needs a USB-UART adapter wired to the ESP32's RTS/CTS pins (USE_HW_FLOW_CONTROL in the sketch).
+USE_HW_FLOW_CONTROL = False
+
+# read_reply() to send_frame() are the same as in
+# USB_Stream_GenAI_Image/gemini_image_sender_final_sanitised.py; keep them in step.
+def read_reply(ser, prefixes, timeout):
+    """Reads lines until one starts with a prefix in `prefixes` (debug lines are skipped). Returns '' on timeout."""
+    ser.timeout = timeout
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = ser.readline()
+        if not line:
+            break
+        reply = line.decode('utf-8', errors='replace').strip()
+        if reply.startswith(prefixes):
+            return reply
+    return ""
+
+def try_baud_rate(ser, rate, test_bytes=BAUD_TEST_BYTES):
+    """Moves both ends to `rate` and verifies it with a test pattern.
+
+    Returns (ok, host_seconds, device_micros). On failure both ends are back at the
+    rate the link had before.
+    """
+    previous = ser.baudrate
+    ser.reset_input_buffer()
+    ser.write(f"BAUD {rate}\n".encode())
+    if not read_reply(ser, ("BAUD_OK", "BAUD_ERR"), 2).startswith("BAUD_OK"):
+        return False, 0.0, 0
+
+    time.sleep(BAUD_SWITCH_SETTLE)
+    ser.baudrate = rate
+    time.sleep(BAUD_SWITCH_SETTLE)
+    ser.reset_input_buffer()
+
+    # A pattern with every byte value and long runs of neither, so both framing and
+    # bit errors show up in the CRC.
+    pattern = np.random.default_rng(rate).integers(0, 256, test_bytes, dtype=np.uint8).tobytes()
+    start = time.time()
+    ser.write(f"BAUD_TEST {len(pattern)} {zlib.crc32(pattern) & 0xFFFFFFFF}\n".encode() + pattern)
+    reply = read_reply(ser, ("BAUD_PASS", "BAUD_FAIL"), test_bytes * 10 / rate + 2)
+    host_seconds = time.time() - start
+
+    if reply.startswith(f"BAUD_PASS {rate} "):
+        return True, host_seconds, int(reply.split()[2])
+
+    # The ESP32 falls back on its own and confirms with BAUD_FAIL at the old rate.
+    ser.baudrate = previous
+    time.sleep(BAUD_SWITCH_SETTLE)
+    read_reply(ser, ("BAUD_FAIL",), 2)
+    ser.reset_input_buffer()
+    return False, host_seconds, 0
+
+def print_baud_result(rate, ok, host_seconds, device_micros, test_bytes):
+    if not ok:
+        print(f"  {rate:>8} baud: FAILED")
+        return
+    wire_kbs = test_bytes / device_micros * 1e6 / 1024
+    host_kbs = test_bytes / host_seconds / 1024
+    print(f"  {rate:>8} baud: ok, {host_kbs:7.1f} KB/s incl. round trip, {wire_kbs:7.1f} KB/s on the wire "
+          f"({100 * wire_kbs * 1024 * 10 / rate:.0f}% of line rate)")
+
+def negotiate_baud(ser, candidates=BAUD_CANDIDATES):
+    """Settles on the fastest candidate that passes the test pattern. Returns the rate in use."""
+    print(f"[BAUD] Negotiating from {ser.baudrate} baud...")
+    for rate in candidates:
+        if rate <= ser.baudrate:
+            break
+        ok, host_seconds, device_micros = try_baud_rate(ser, rate)
+        print_baud_result(rate, ok, host_seconds, device_micros, BAUD_TEST_BYTES)
+        if ok:
+            return rate
+    print(f"[BAUD] Staying at {ser.baudrate} baud.")
+    return ser.baudrate
+
+def send_frame(ser, frame):
+    """Sends one START_FRAME transfer. Returns the ESP32's OK/ERR line ('' on timeout) and the seconds
+    from the first frame byte to the ack."""
+    ser.reset_input_buffer()
+    ser.write(START_FRAME_COMMAND.encode())
+    time.sleep(0.5)
+    start = time.time()
+    ser.write(frame)
+    return read_reply(ser, ("OK ", "ERR "), ACK_TIMEOUT), time.time() - start
+
+def encode_frame(raw_data, frame_id):
+    """Prepends the 32-byte frame header (geometry and CRC-32) to a raw full-screen image."""
+    return struct.pack(FRAME_HEADER_FORMAT, FRAME_MAGIC, FRAME_PROTOCOL_VERSION,
+                       PIXFMT_RGB565, ENC_RAW, 0, 0, 0, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT,
+                       len(raw_data), frame_id, zlib.crc32(raw_data) & 0xFFFFFFFF) + raw_data
 
 def send_image_serial():
     if not os.path.exists(FILE_PATH):
@@ -17,34 +133,41 @@ def send_image_serial():
         with open(FILE_PATH, 'rb') as f:
             raw_data = f.read()
         
-        expected_size = 320 * 170 * 2
+        expected_size = IMAGE_WIDTH * IMAGE_HEIGHT * 2
         if len(raw_data) != expected_size:
             print(f"Error: File size mismatch. Expected {expected_size} bytes, got {len(raw_data)} bytes.")
             return
 
         print(f"Connecting to {COM_PORT} at {BAUD_RATE}...")
         
-        ser = serial.Serial(COM_PORT, BAUD_RATE)
-        ser.write_timeout = 1 
+        ser = serial.Serial(COM_PORT, BAUD_RATE, rtscts=USE_HW_FLOW_CONTROL)
+        ser.write_timeout = ACK_TIMEOUT 
         time.sleep(2) 
+        ser.reset_input_buffer()
 
-        # --- STEP 1: SEND START COMMAND ---
-        print(f"Sending start command: {START_COMMAND.strip()}")
-        ser.write(START_COMMAND.encode())
-        time.sleep(0.5) # Wait for the ESP32 to enter the read function
+        # A frame that fails at a raised rate is resent one rate lower; the CRC in
+        # the header is what tells the two apart.
+        candidates = BAUD_CANDIDATES if NEGOTIATE_BAUD else []
+        for attempt in range(1, MAX_SEND_ATTEMPTS + 1):
+            rate = negotiate_baud(ser, candidates)
+            print(f"Sending {len(raw_data)} bytes of image data as frame {attempt} at {rate} baud...")
+            ack, elapsed = send_frame(ser, encode_frame(raw_data, attempt))
 
-        # --- STEP 2: SEND RAW DATA ---
-        print(f"Sending {len(raw_data)} bytes of image data over Serial...")
-        
-        bytes_sent = ser.write(raw_data)
-        
-        ser.close()
+            if ack.startswith("OK "):
+                print("--- SUCCESS ---")
+                print(f"Image acknowledged in {elapsed:.2f} s ({len(raw_data) / elapsed / 1024:.1f} KB/s effective).")
+                break
+            print(f"--- FAILURE --- (ESP32 replied '{ack}' at {rate} baud)")
+            if rate == BAUD_RATE:
+                break
+            # The ESP32 drops to BAUD_RATE after an ERR, or after BAUD_LEASE of silence
+            # if the frame never completed. Follow it and renegotiate one step lower.
+            time.sleep(BAUD_LEASE)
+            ser.baudrate = BAUD_RATE
+            ser.reset_input_buffer()
+            candidates = [r for r in candidates if r < rate]
 
-        if bytes_sent == expected_size:
-            print("--- SUCCESS ---")
-            print("Image transmission successful. The screen should now be displaying the image.")
-        else:
-            print(f"--- FAILURE --- (Only sent {bytes_sent} of {expected_size})")
+        ser.close()
 
     except serial.SerialException as e:
         print("--- SERIAL CONNECTION ERROR ---")
@@ -0,0 +1,99 @@
+"""Native RGB888 -> RGB565 packing for the host tools (see rgb565.h).
+
+The shared library is compiled from rgb565.cpp the first time it is needed,
+with $CXX (or c++), and rebuilt whenever the sources are newer. If there is
+no compiler, available() is False and callers keep their numpy path.
+"""
+import ctypes
+import os
+import subprocess
+
+import numpy as np
+
+BGR = 0x01
+SWAP_BYTES = 0x02
+KERNELS = ("scalar", "sse2", "avx2")
+DITHERS = ("none", "bayer", "floyd-steinberg")
+
+_HERE = os.path.dirname(os.path.abspath(__file__))
+_SOURCES = [os.path.join(_HERE, name) for name in ("rgb565.cpp", "rgb565.h")]
+_LIBRARY = os.path.join(_HERE, "_rgb565.so")
+_lib = None
+_load_failed = False
+
+def _build():
+    compiler = os.environ.get("CXX", "c++")
+    command = [compiler, "-O3", "-shared", "-fPIC", "-pthread", "-o", _LIBRARY, _SOURCES[0]]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        raise OSError(f"{' '.join(command)} failed:\n{result.stderr}")
+
+def _load():
+    global _lib, _load_failed
+    if _lib is not None or _load_failed:
+        return _lib
+    try:
+        stale = not os.path.exists(_LIBRARY) or \
+                os.path.getmtime(_LIBRARY) < max(os.path.getmtime(path) for path in _SOURCES)
+        if stale:
+            _build()
+        lib = ctypes.CDLL(_LIBRARY)
+        lib.rgb565_best_kernel.restype = ctypes.c_int
+        lib.rgb565_best_kernel.argtypes = []
+        lib.rgb565_pack.restype = ctypes.c_int
+        lib.rgb565_pack.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        lib.rgb565_pack_dithered.restype = ctypes.c_int
+        lib.rgb565_pack_dithered.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p,
+                                             ctypes.c_int, ctypes.c_int, ctypes.c_int]
+        _lib = lib
+    except (OSError, subprocess.SubprocessError) as e:
+        print(f"[RGB565] Native library unavailable, using numpy: {e}")
+        _load_failed = True
+    return _lib
+
+def available():
+    return _load() is not None
+
+def best_kernel():
+    """Name of the fastest kernel this CPU runs."""
+    return KERNELS[_load().rgb565_best_kernel()]
+
+def supported_kernels():
+    lib = _load()
+    probe = np.zeros((1, 3), dtype=np.uint8)
+    out = np.empty(1, dtype=np.uint16)
+    return [name for index, name in enumerate(KERNELS)
+            if lib.rgb565_pack(probe.ctypes.data, 1, out.ctypes.data, 0, index) >= 0]
+
+def pack(rgb, bgr=False, swap_bytes=False, kernel=None):
+    """Packs an (..., 3) uint8 array into a uint16 array of shape (...).
+
+    bgr puts blue in the top 5 bits; swap_bytes stores each pixel high byte
+    first. kernel is one of KERNELS, or None for the fastest supported one.
+    """
+    lib = _load()
+    rgb = np.ascontiguousarray(rgb, dtype=np.uint8)
+    if rgb.shape[-1] != 3:
+        raise ValueError(f"expected RGB triplets, got shape {rgb.shape}")
+    out = np.empty(rgb.shape[:-1], dtype=np.uint16)
+    flags = (BGR if bgr else 0) | (SWAP_BYTES if swap_bytes else 0)
+    index = -1 if kernel is None else KERNELS.index(kernel)
+    if lib.rgb565_pack(rgb.ctypes.data, out.size, out.ctypes.data, flags, index) < 0:
+        raise ValueError(f"kernel '{kernel}' is not supported on this CPU")
+    return out
+
+def pack_dithered(rgb, dither, bgr=False, swap_bytes=False, threads=0):
+    """Packs an (H, W, 3) uint8 image into (H, W) uint16 through one of DITHERS.
+
+    The rows are split over `threads` threads; 0 means one per core, but
+    no more than the image is big enough to keep busy.
+    """
+    lib = _load()
+    rgb = np.ascontiguousarray(rgb, dtype=np.uint8)
+    if rgb.ndim != 3 or rgb.shape[2] != 3:
+        raise ValueError(f"expected an (H, W, 3) image, got shape {rgb.shape}")
+    out = np.empty(rgb.shape[:2], dtype=np.uint16)
+    flags = (BGR if bgr else 0) | (SWAP_BYTES if swap_bytes else 0)
+    lib.rgb565_pack_dithered(rgb.ctypes.data, rgb.shape[1], rgb.shape[0], out.ctypes.data,
+                             flags, DITHERS.index(dither), threads)
+    return out
@@ -0,0 +1,326 @@
+/**
+ * @file rgb565.cpp
+ * @brief RGB888 -> RGB565 / BGR565 packing: AVX2, SSE2 and scalar kernels.
+ *
+ * Every kernel gives the same bits as to_rgb565() in sensor_ai_display_loop.py
+ * (truncate to 5/6/5 bits). The SIMD kernels put one pixel in each 32-bit lane,
+ * mask and shift all three channels into place there, and narrow the lanes to
+ * 16 bits; the few pixels left over at the end go through the scalar kernel.
+ * The x86 kernels are compiled with per-function target attributes and picked
+ * at run time, so one build runs on any x86-64 CPU. Other CPUs get the scalar
+ * kernel, which compilers auto-vectorise reasonably well.
+ *
+ * rgb565_pack_dithered() dithers in front of the same kernels, splitting the
+ * rows over threads: Bayer in independent bands, Floyd-Steinberg as a wavefront.
+ */
+#include "rgb565.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RGB565_X86 1
+#include <immintrin.h>
+#endif
+
+// --------------------------------------------------------
+// --- SCALAR ---
+// --------------------------------------------------------
+template <int FLAGS>
+static inline uint16_t packPixel(uint8_t r, uint8_t g, uint8_t b) {
+  const uint8_t top = (FLAGS & RGB565_BGR) ? b : r;
+  const uint8_t bottom = (FLAGS & RGB565_BGR) ? r : b;
+  uint16_t p = (uint16_t)((top & 0xF8) << 8 | (g & 0xFC) << 3 | bottom >> 3);
+  return (FLAGS & RGB565_SWAP_BYTES) ? (uint16_t)(p << 8 | p >> 8) : p;
+}
+
+template <int FLAGS>
+static void packScalar(const uint8_t* rgb, size_t begin, size_t end, uint16_t* out) {
+  for (size_t i = begin; i < end; i++) {
+    out[i] = packPixel<FLAGS>(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+  }
+}
+
+#if RGB565_X86
+// --------------------------------------------------------
+// --- SSE2: 8 PIXELS PER ITERATION ---
+// --------------------------------------------------------
+// Lane holds R | G << 8 | B << 16 | (next pixel's byte) << 24; result in the low 16 bits.
+template <int FLAGS>
+__attribute__((target("sse2")))
+static inline __m128i packLanes128(__m128i v) {
+  __m128i g = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFC00)), 5);
+  __m128i r = _mm_and_si128(v, _mm_set1_epi32(0xF8));
+  __m128i b = _mm_and_si128(v, _mm_set1_epi32(0xF80000));
+  if (FLAGS & RGB565_BGR) {
+    r = _mm_srli_epi32(r, 3);
+    b = _mm_srli_epi32(b, 8);
+  } else {
+    r = _mm_slli_epi32(r, 8);
+    b = _mm_srli_epi32(b, 19);
+  }
+  return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+// Four pixels from 12 bytes, one per 32-bit lane. Reads 16 bytes.
+__attribute__((target("sse2")))
+static inline __m128i loadPixels4(const uint8_t* p) {
+  __m128i a = _mm_loadu_si128((const __m128i*)p);
+  __m128i ab = _mm_unpacklo_epi32(a, _mm_srli_si128(a, 3));
+  __m128i cd = _mm_unpacklo_epi32(_mm_srli_si128(a, 6), _mm_srli_si128(a, 9));
+  return _mm_unpacklo_epi64(ab, cd);
+}
+
+template <int FLAGS>
+__attribute__((target("sse2")))
+static size_t packSse2(const uint8_t* rgb, size_t pixels, uint16_t* out) {
+  // SSE2 only has a signed 32 -> 16 bit pack: bias into its range and back.
+  const __m128i bias32 = _mm_set1_epi32(0x8000);
+  const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+  size_t i = 0;
+  for (; 3 * i + 28 <= 3 * pixels; i += 8) {
+    const uint8_t* p = rgb + 3 * i;
+    __m128i lo = _mm_sub_epi32(packLanes128<FLAGS>(loadPixels4(p)), bias32);
+    __m128i hi = _mm_sub_epi32(packLanes128<FLAGS>(loadPixels4(p + 12)), bias32);
+    __m128i px = _mm_add_epi16(_mm_packs_epi32(lo, hi), bias16);
+    if (FLAGS & RGB565_SWAP_BYTES) px = _mm_or_si128(_mm_slli_epi16(px, 8), _mm_srli_epi16(px, 8));
+    _mm_storeu_si128((__m128i*)(out + i), px);
+  }
+  return i;
+}
+
+// --------------------------------------------------------
+// --- AVX2: 16 PIXELS PER ITERATION ---
+// --------------------------------------------------------
+template <int FLAGS>
+__attribute__((target("avx2")))
+static inline __m256i packLanes256(__m256i v) {
+  __m256i g = _mm256_srli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFC00)), 5);
+  __m256i r = _mm256_and_si256(v, _mm256_set1_epi32(0xF8));
+  __m256i b = _mm256_and_si256(v, _mm256_set1_epi32(0xF80000));
+  if (FLAGS & RGB565_BGR) {
+    r = _mm256_srli_epi32(r, 3);
+    b = _mm256_srli_epi32(b, 8);
+  } else {
+    r = _mm256_slli_epi32(r, 8);
+    b = _mm256_srli_epi32(b, 19);
+  }
+  return _mm256_or_si256(_mm256_or_si256(r, g), b);
+}
+
+// Eight pixels from 24 bytes, one per 32-bit lane. Reads 28 bytes.
+__attribute__((target("avx2")))
+static inline __m256i loadPixels8(const uint8_t* p) {
+  const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                      _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+  return _mm256_shuffle_epi8(v, spread);
+}
+
+template <int FLAGS>
+__attribute__((target("avx2")))
+static size_t packAvx2(const uint8_t* rgb, size_t pixels, uint16_t* out) {
+  size_t i = 0;
+  for (; 3 * i + 52 <= 3 * pixels; i += 16) {
+    const uint8_t* p = rgb + 3 * i;
+    __m256i lo = packLanes256<FLAGS>(loadPixels8(p));
+    __m256i hi = packLanes256<FLAGS>(loadPixels8(p + 24));
+    // packus works per 128-bit half: [lo 0-3, hi 8-11, lo 4-7, hi 12-15]; restore pixel order.
+    __m256i px = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+    if (FLAGS & RGB565_SWAP_BYTES) px = _mm256_or_si256(_mm256_slli_epi16(px, 8), _mm256_srli_epi16(px, 8));
+    _mm256_storeu_si256((__m256i*)(out + i), px);
+  }
+  return i;
+}
+#endif  // RGB565_X86
+
+template <int FLAGS>
+static void packWith(int kernel, const uint8_t* rgb, size_t pixels, uint16_t* out) {
+  size_t done = 0;
+#if RGB565_X86
+  if (kernel == RGB565_KERNEL_AVX2) done = packAvx2<FLAGS>(rgb, pixels, out);
+  if (kernel == RGB565_KERNEL_SSE2) done = packSse2<FLAGS>(rgb, pixels, out);
+#endif
+  packScalar<FLAGS>(rgb, done, pixels, out);
+}
+
+// --------------------------------------------------------
+// --- C INTERFACE ---
+// --------------------------------------------------------
+static bool kernelSupported(int kernel) {
+  switch (kernel) {
+    case RGB565_KERNEL_SCALAR: return true;
+#if RGB565_X86
+    case RGB565_KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+    case RGB565_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+    default: return false;
+  }
+}
+
+extern "C" int rgb565_best_kernel(void) {
+  for (int kernel = RGB565_KERNEL_AVX2; kernel > RGB565_KERNEL_SCALAR; kernel--) {
+    if (kernelSupported(kernel)) return kernel;
+  }
+  return RGB565_KERNEL_SCALAR;
+}
+
+static void packAny(int kernel, const uint8_t* rgb, size_t pixels, uint16_t* out, int flags) {
+  switch (flags & (RGB565_BGR | RGB565_SWAP_BYTES)) {
+    case 0:                 packWith<0>(kernel, rgb, pixels, out); break;
+    case RGB565_BGR:        packWith<RGB565_BGR>(kernel, rgb, pixels, out); break;
+    case RGB565_SWAP_BYTES: packWith<RGB565_SWAP_BYTES>(kernel, rgb, pixels, out); break;
+    default:                packWith<RGB565_BGR | RGB565_SWAP_BYTES>(kernel, rgb, pixels, out); break;
+  }
+}
+
+extern "C" int rgb565_pack(const uint8_t* rgb, size_t pixels, uint16_t* out, int flags, int kernel) {
+  if (kernel < 0) kernel = rgb565_best_kernel();
+  if (!kernelSupported(kernel)) return -1;
+  packAny(kernel, rgb, pixels, out, flags);
+  return kernel;
+}
+
+// --------------------------------------------------------
+// --- DITHERING ---
+// --------------------------------------------------------
+// Both dithers keep the packing's convention that a 5-bit code c stands for
+// c << 3, so a colour the panel can show exactly comes out unchanged.
+static const uint8_t BAYER8[8][8] = {
+  { 0, 32,  8, 40,  2, 34, 10, 42},
+  {48, 16, 56, 24, 50, 18, 58, 26},
+  {12, 44,  4, 36, 14, 46,  6, 38},
+  {60, 28, 52, 20, 62, 30, 54, 22},
+  { 3, 35, 11, 43,  1, 33,  9, 41},
+  {51, 19, 59, 27, 49, 17, 57, 25},
+  {15, 47,  7, 39, 13, 45,  5, 37},
+  {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+// Floyd-Steinberg rows publish their progress every this many pixels.
+static const size_t FS_CHUNK = 32;
+
+// With threads = 0, fewest pixels worth a thread each. Starting one costs tens
+// of microseconds: about 20k pixels of Bayer, or 4k of Floyd-Steinberg.
+static const size_t BAYER_PIXELS_PER_THREAD = 65536;
+static const size_t FS_PIXELS_PER_THREAD = 16384;
+
+// Runs band(first, end) over `threads` contiguous bands of rows, one per thread.
+template <typename Band>
+static void forEachBand(size_t height, int threads, Band band) {
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++) {
+    workers.emplace_back(band, height * t / threads, height * (t + 1) / threads);
+  }
+  band(0, height / threads);
+  for (std::thread& worker : workers) worker.join();
+}
+
+// Adds the 8x8 threshold, scaled to just under one 5- or 6-bit step, to every
+// byte (saturating) and packs the row. Rows are independent.
+static void ditherBayer(const uint8_t* rgb, size_t width, size_t height, uint16_t* out, int flags, int threads) {
+  if (width == 0 || height == 0) return;  // thresholds would be empty
+  const size_t stride = width * 3;
+  std::vector<uint8_t> thresholds(8 * stride);  // one row of byte offsets per matrix row
+  for (size_t y = 0; y < 8; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const uint8_t m = BAYER8[y][x & 7];
+      thresholds[y * stride + 3 * x] = m >> 3;
+      thresholds[y * stride + 3 * x + 1] = m >> 4;
+      thresholds[y * stride + 3 * x + 2] = m >> 3;
+    }
+  }
+
+  const int kernel = rgb565_best_kernel();
+  forEachBand(height, threads, [&](size_t first, size_t end) {
+    std::vector<uint8_t> row(stride);
+    for (size_t y = first; y < end; y++) {
+      const uint8_t* src = rgb + y * stride;
+      const uint8_t* add = &thresholds[(y & 7) * stride];
+      for (size_t i = 0; i < stride; i++) {
+        const unsigned v = src[i] + add[i];
+        row[i] = v > 255 ? 255 : (uint8_t)v;
+      }
+      packAny(kernel, row.data(), width, out + y * width, flags);
+    }
+  });
+}
+
+// Left-to-right error diffusion: 7/16 right, 3/16 below left, 5/16 below,
+// 1/16 below right. Pixel x of row y needs row y - 1 to have finished pixel
+// x + 1, so thread t takes rows t, t + threads, ... and each row trails the
+// one above it by a chunk, waiting on the progress that row publishes.
+static void ditherFloydSteinberg(const uint8_t* rgb, size_t width, size_t height, uint16_t* out, int flags,
+                                 int threads) {
+  const size_t stride = width * 3;
+  const size_t padded = (width + 2) * 3;  // a pixel of padding each side takes the edge errors
+  std::vector<int16_t> errors((height + 1) * padded, 0);  // in sixteenths, diffused into each row
+  std::unique_ptr<std::atomic<size_t>[]> done(new std::atomic<size_t>[height]);
+  for (size_t y = 0; y < height; y++) done[y].store(0, std::memory_order_relaxed);
+
+  const int kernel = rgb565_best_kernel();
+  auto rows = [&](size_t first) {
+    std::vector<uint8_t> row(stride);
+    for (size_t y = first; y < height; y += threads) {
+      const uint8_t* src = rgb + y * stride;
+      const int16_t* in = &errors[y * padded + 3];
+      int16_t* below = &errors[(y + 1) * padded + 3];
+      int right[3] = {0, 0, 0};
+      for (size_t x0 = 0; x0 < width; x0 += FS_CHUNK) {
+        const size_t x1 = x0 + FS_CHUNK < width ? x0 + FS_CHUNK : width;
+        if (y > 0) {
+          const size_t needed = x1 + 1 < width ? x1 + 1 : width;
+          while (done[y - 1].load(std::memory_order_acquire) < needed) std::this_thread::yield();
+        }
+        for (size_t x = x0; x < x1; x++) {
+          for (int c = 0; c < 3; c++) {
+            const size_t i = 3 * x + c;
+            int v = src[i] + ((in[i] + right[c] + 8) >> 4);
+            if (v > 255) v = 255;
+            const int q = v & (c == 1 ? 0xFC : 0xF8);
+            const int e = v - q;
+            row[i] = (uint8_t)q;
+            right[c] = 7 * e;
+            below[i - 3] += 3 * e;
+            below[i] += 5 * e;
+            below[i + 3] += e;
+          }
+        }
+        done[y].store(x1, std::memory_order_release);
+      }
+      packAny(kernel, row.data(), width, out + y * width, flags);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++) workers.emplace_back(rows, (size_t)t);
+  rows(0);
+  for (std::thread& worker : workers) worker.join();
+}
+
+extern "C" int rgb565_pack_dithered(const uint8_t* rgb, size_t width, size_t height, uint16_t* out, int flags,
+                                    int dither, int threads) {
+  if (threads <= 0) {
+    const size_t perThread = dither == RGB565_DITHER_BAYER ? BAYER_PIXELS_PER_THREAD : FS_PIXELS_PER_THREAD;
+    threads = (int)std::thread::hardware_concurrency();
+    if ((size_t)threads > width * height / perThread) threads = (int)(width * height / perThread);
+  }
+  if ((size_t)threads > height) threads = (int)height;
+  if (threads < 1) threads = 1;
+  switch (dither) {
+    case RGB565_DITHER_NONE:
+      packAny(rgb565_best_kernel(), rgb, width * height, out, flags);
+      return 1;
+    case RGB565_DITHER_BAYER:
+      ditherBayer(rgb, width, height, out, flags, threads);
+      return threads;
+    case RGB565_DITHER_FLOYD_STEINBERG:
+      ditherFloydSteinberg(rgb, width, height, out, flags, threads);
+      return threads;
+    default:
+      return -1;
+  }
+}
@@ -0,0 +1,45 @@
+/**
+ * @file rgb565.h
+ * @brief One-pass RGB888 -> RGB565 / BGR565 packing for the host tools.
+ *
+ * Loaded from Python through ctypes (see __init__.py); built on first use as a
+ * shared library. Plain C interface so no name mangling gets in the way.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// pack flags
+#define RGB565_BGR        0x01  // blue in the top 5 bits (BGR565), as the LVGL arrays expect
+#define RGB565_SWAP_BYTES 0x02  // high byte first in memory, as the panel receives it
+
+// Kernels, fastest last. rgb565_best_kernel() picks the fastest this CPU runs.
+#define RGB565_KERNEL_SCALAR 0
+#define RGB565_KERNEL_SSE2   1
+#define RGB565_KERNEL_AVX2   2
+
+// Dithers for rgb565_pack_dithered()
+#define RGB565_DITHER_NONE            0
+#define RGB565_DITHER_BAYER           1  // 8x8 ordered: cheap and stable from frame to frame, for animation
+#define RGB565_DITHER_FLOYD_STEINBERG 2  // error diffusion: smoother, for stills
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int rgb565_best_kernel(void);
+
+// Packs `pixels` RGB888 triplets into `out`. Returns the kernel used, or -1 if
+// `kernel` is not supported on this CPU (or build). kernel < 0 means the best one.
+int rgb565_pack(const uint8_t* rgb, size_t pixels, uint16_t* out, int flags, int kernel);
+
+// Packs a width x height image through `dither`, with the best kernel, its rows
+// split over `threads` threads (0: one per core, fewer for small images).
+// Returns the number of threads used, or -1 for an unknown dither.
+int rgb565_pack_dithered(const uint8_t* rgb, size_t width, size_t height, uint16_t* out, int flags,
+                         int dither, int threads);
+
+#ifdef __cplusplus
+}
+#endif
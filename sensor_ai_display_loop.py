@@ -3,9 +3,17 @@ import time
 import numpy as np
 import sys
 import io
-from PIL import Image
+import struct
+import zlib
+import os
+import hashlib
+import argparse
+import select
+import threading
+from PIL import Image, ImageDraw, ImageFont
 import requests
 import base64
+import rgb565_native
 
 # --- API Configuration ---
 STABILITY_API_KEY = "" 
@@ -23,6 +31,101 @@ IMAGE_WIDTH = 320
 IMAGE_HEIGHT = 170  
 EXPECTED_SIZE = IMAGE_WIDTH * IMAGE_HEIGHT * 2 
 POLLING_INTERVAL = 30 # seconds
+USE_NATIVE_RGB565 = True  # pack pixels with rgb565_native (built on first use); numpy if it can't be built
+# Dithering before the 5/6/5-bit truncation, so smooth gradients don't band: "none", "bayer" or "floyd-steinberg".
+DITHER_STILL = "none"             # generated images; "floyd-steinberg" removes banding at the cost of RLE size
+DITHER_ANIMATION = "bayer"        # --stream delta frames: the ordered pattern stays put, so unchanged areas still diff away
+DITHER_THREADS = 0                # native dither threads (0: one per core, fewer for small frames)
+
+# --- Transfer Mode ---
+# "lossless":   RGB565 as raw, RLE or dirty tiles, whichever is smallest.
+# "jpeg":       resize the API's JPEG to the panel and send it as JPEG (a few KB, decoded on the ESP32).
+# "palette256": quantize to 256 colours, 1 byte per pixel.
+# "palette16":  quantize to 16 colours, 2 pixels per byte.
+TRANSFER_MODE = "lossless"
+# True: push each image once to the multicast group (all displays) instead of TCP to ESP32_IP_ADDRESS.
+USE_MULTICAST = False
+JPEG_QUALITY = 85
+
+# --- Frame Protocol (must match FrameHeader in DIYMORE_LCD_Gen_Ai_WIFI.ino) ---
+FRAME_MAGIC = b'IMGF'
+FRAME_PROTOCOL_VERSION = 1
+# magic, version, format, encoding, reserved0, flags, reserved1, x, y, w, h, payload_len, frame_id, crc32
+FRAME_HEADER_FORMAT = '<4sBBBBHHHHHHIII'
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER_FORMAT)  # 32 bytes
+PIXFMT_RGB565 = 0
+PIXFMT_PAL8 = 1
+PIXFMT_PAL4 = 2
+ENC_RAW = 0
+ENC_TILES = 1
+ENC_RLE = 2
+ENC_JPEG = 3
+MAX_JPEG_BYTES = 48 * 1024  # MAX_JPEG_BYTES on the ESP32
+TILE_HEADER_FORMAT = '<HHBB'  # x, y, w, h; followed by w*h RGB565 pixels
+TILE_SIZE = 16
+ACK_TIMEOUT = 5 # seconds to wait for the "OK <id>" line after a frame
+
+# Resumable raw frames: after a dropped connection, ask the ESP32 which row it
+# reached ("IMGQ" + frame id -> "RESUME <id> <row>") and send only the rest.
+RESUME_MAGIC = b'IMGQ'
+RESUME_QUERY_FORMAT = '<4sI'
+FRAME_FLAG_CONTINUATION = 0x0001
+FRAME_FLAG_CREDIT = 0x0004     # 0x0002 is FRAME_FLAG_INTERLACED on the USB link
+FRAME_KNOWN_FLAGS = FRAME_FLAG_CONTINUATION | FRAME_FLAG_CREDIT
+MAX_RESUME_ATTEMPTS = 3
+RESUME_RETRY_DELAY = 1 # seconds
+
+# Credit flow control for raw RGB565 frames: the ESP32 answers the header with
+# "CREDIT <id> <rows>" and grants more rows as it draws; the host never sends
+# rows it holds no credit for, so the ESP32's receive window never fills.
+USE_CREDIT_FLOW = True
+
+# --- Low-Resolution Frames (must match SCALE_* in DIYMORE_LCD_Gen_Ai_WIFI.ino) ---
+# A factor of 2 or 4 in the header's scale byte makes the payload a raw RGB565
+# source of ceil(w/f) x ceil(h/f) pixels, upscaled by the ESP32 as it streams.
+SCALE_BILINEAR = 0x80
+SCALE_FACTORS = (1, 2, 4)
+SCALE_FILTER = "bilinear"      # or "nearest"
+USE_ADAPTIVE_SCALE = True      # lossless mode: send 2x/4x sources while the link is too slow for full frames
+SCALE_TIME_BUDGET = 0.5        # seconds a frame may take at the measured throughput
+SCALE_MIN_SAMPLE_BYTES = 4096  # smaller frames measure latency more than throughput (4x sources are 6880)
+
+# --- Animation Streams (must match STREAM_MAGIC in DIYMORE_LCD_Gen_Ai_WIFI.ino) ---
+# "IMGS" + frame period starts a paced stream on the session; frames that arrive a
+# whole period late are answered "ERR <id> late" and skipped. Only dirty-tile frames
+# are deltas and are shown late instead; an RLE frame can be skipped like a JPEG one.
+# A period of 0 ends it.
+STREAM_MAGIC = b'IMGS'
+STREAM_CONTROL_FORMAT = '<4sI'  # magic, frame period in microseconds
+STREAM_FPS = 15
+STREAM_SECONDS = 10
+STREAM_ENCODING = "jpeg"        # "jpeg" or "delta" (lossless; late tile frames are shown late, not dropped)
+STREAM_MAX_IN_FLIGHT = 2        # frames sent ahead of their ack, so the ESP32 never waits on the network
+
+# --- Flash Frame Cache (must match CACHE_MAGIC in DIYMORE_LCD_Gen_Ai_WIFI.ino) ---
+# Before a full image, only its content key is sent ("IMGH" + frame id + key).
+# "HIT <id>": the ESP32 redrew the image from flash and no payload follows.
+# "MISS <id>": the frame follows as usual with the same id, and the ESP32 caches it.
+CACHE_MAGIC = b'IMGH'
+CACHE_QUERY_FORMAT = '<4sIQ'    # magic, frame id, 64-bit content key
+USE_DEVICE_CACHE = True
+
+# --- Multicast (must match McastHeader in DIYMORE_LCD_Gen_Ai_WIFI.ino) ---
+# One UDP stream feeds every display in the group; each display NACKs only the rows it missed.
+MULTICAST_GROUP = '239.0.80.90'
+MULTICAST_PORT = 8090
+MULTICAST_TTL = 1              # stay on the local network
+MULTICAST_INTERFACE = ''       # local IP of the interface facing the displays ('' = OS default route)
+MCAST_MAGIC = b'IMGU'
+MCAST_NACK_MAGIC = b'IMGN'
+MCAST_ACK_MAGIC = b'IMGA'
+MCAST_HEADER_FORMAT = '<4sBBHHHI'  # magic, type, reserved, first_row, row_count, total_rows, frame_id
+MCAST_DATA = 0
+MCAST_END = 1
+MCAST_ROWS_PER_PACKET = 2      # 16 + 2 * 640 bytes fits one 1472-byte UDP payload
+MCAST_PACKET_INTERVAL = 0.0015 # seconds between packets; the ESP32's UDP queue is only a few packets deep
+MCAST_NACK_WINDOW = 0.3        # seconds to collect NACKs after each END
+MCAST_MAX_REPAIR_ROUNDS = 5
 
 # -----------------------------------------------------------------------------
 # *** UTILITY FUNCTIONS (Generation, Conversion, Send Image - UNCHANGED) ***
@@ -49,25 +152,86 @@ def generate_image_from_prompt(prompt, api_key):
         print(f"--- ERROR: Image Generation Failed --- Details: {e}")
         return None
 
-def convert_to_rgb565_raw(pil_image):
-    """Resizes and converts the PIL Image to raw 16-bit RGB565 binary data."""
-    if pil_image.size != (IMAGE_WIDTH, IMAGE_HEIGHT):
-        img_resized = pil_image.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
-    else:
-        img_resized = pil_image
+BAYER_8X8 = np.array([
+    [ 0, 32,  8, 40,  2, 34, 10, 42],
+    [48, 16, 56, 24, 50, 18, 58, 26],
+    [12, 44,  4, 36, 14, 46,  6, 38],
+    [60, 28, 52, 20, 62, 30, 54, 22],
+    [ 3, 35, 11, 43,  1, 33,  9, 41],
+    [51, 19, 59, 27, 49, 17, 57, 25],
+    [15, 47,  7, 39, 13, 45,  5, 37],
+    [63, 31, 55, 23, 61, 29, 53, 21],
+], dtype=np.uint16)
 
-    img_rgb = img_resized.convert("RGB")
-    np_array = np.array(img_rgb, dtype=np.uint8)
+def dither_bayer(rgb):
+    """Adds the 8x8 ordered threshold, just under one 5/6-bit step, ahead of truncation.
+
+    Bit-identical to the Bayer kernel in rgb565_native.
+    """
+    h, w, _ = rgb.shape
+    m = np.tile(BAYER_8X8, (-(-h // 8), -(-w // 8)))[:h, :w]
+    return np.minimum(rgb + np.stack([m >> 3, m >> 4, m >> 3], axis=-1), 255).astype(np.uint8)
+
+def dither_floyd_steinberg(rgb):
+    """Floyd-Steinberg in front of truncation, error in sixteenths, one pixel at a time.
+
+    Bit-identical to the native kernel, and a few hundred times slower.
+    """
+    h, w, _ = rgb.shape
+    masks = (0xF8, 0xFC, 0xF8)
+    out = []
+    below = [[0, 0, 0] for _ in range(w + 2)]
+    for src in rgb.tolist():
+        errors, below = below, [[0, 0, 0] for _ in range(w + 2)]
+        right = [0, 0, 0]
+        row = []
+        for x in range(w):
+            pixel = []
+            for c in range(3):
+                v = min(255, src[x][c] + ((errors[x + 1][c] + right[c] + 8) >> 4))
+                q = v & masks[c]
+                e = v - q
+                pixel.append(q)
+                right[c] = 7 * e
+                below[x][c] += 3 * e
+                below[x + 1][c] += 5 * e
+                below[x + 2][c] += e
+            row.append(pixel)
+        out.append(row)
+    return np.array(out, dtype=np.uint8).reshape(h, w, 3)
+
+def to_rgb565(pil_image, dither="none"):
+    """(H, W) uint16 RGB565 pixels of the image at its own size, optionally dithered."""
+    rgb = np.asarray(pil_image.convert("RGB"))
+    if USE_NATIVE_RGB565 and rgb565_native.available():
+        if dither == "none":
+            return rgb565_native.pack(rgb)
+        return rgb565_native.pack_dithered(rgb, dither, threads=DITHER_THREADS)
+    if dither == "bayer":
+        rgb = dither_bayer(rgb)
+    elif dither == "floyd-steinberg":
+        rgb = dither_floyd_steinberg(rgb)
+    return to_rgb565_numpy(Image.fromarray(rgb, "RGB"))
+
+def to_rgb565_numpy(pil_image):
+    np_array = np.array(pil_image.convert("RGB"), dtype=np.uint8)
     
     R = np_array[:, :, 0]
     G = np_array[:, :, 1]
     B = np_array[:, :, 2]
 
-    rgb565 = (R.astype(np.uint16) >> 3) << 11 | \
-             (G.astype(np.uint16) >> 2) << 5 | \
-             (B.astype(np.uint16) >> 3)
-             
-    raw_data = rgb565.astype('<u2').tobytes() 
+    return (R.astype(np.uint16) >> 3) << 11 | \
+           (G.astype(np.uint16) >> 2) << 5 | \
+           (B.astype(np.uint16) >> 3)
+
+def convert_to_rgb565_raw(pil_image, dither=DITHER_STILL):
+    """Resizes and converts the PIL Image to raw 16-bit RGB565 binary data."""
+    if pil_image.size != (IMAGE_WIDTH, IMAGE_HEIGHT):
+        img_resized = pil_image.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
+    else:
+        img_resized = pil_image
+
+    raw_data = to_rgb565(img_resized, dither).astype('<u2').tobytes()
     
     if len(raw_data) != EXPECTED_SIZE:
         raise ValueError(f"Conversion failed: Expected {EXPECTED_SIZE} bytes, got {len(raw_data)}.")
@@ -76,45 +240,860 @@ def convert_to_rgb565_raw(pil_image):
     return raw_data
 
 
-def send_image_tcp(raw_data):
-    """Connects to the ESP32 Image Server (8080) and sends the raw binary data."""
-    print(f"[CLIENT] Connecting to ESP32 Image Server at {ESP32_IP_ADDRESS}:{ESP32_IMAGE_PORT}...")
-    
-    try:
+# -----------------------------------------------------------------------------
+# *** FRAME PROTOCOL ***
+# -----------------------------------------------------------------------------
+_next_frame_id = 1
+_frame_id_lock = threading.Lock()
+
+def allocate_frame_id():
+    """Returns a new frame id; the ESP32 echoes it back in its ack line."""
+    global _next_frame_id
+    with _frame_id_lock:
+        frame_id = _next_frame_id
+        _next_frame_id = (_next_frame_id + 1) & 0xFFFFFFFF
+    return frame_id
+
+def encode_frame(payload, x=0, y=0, w=IMAGE_WIDTH, h=IMAGE_HEIGHT,
+                 pixel_format=PIXFMT_RGB565, encoding=ENC_RAW, frame_id=None, flags=0, scale=0):
+    """Prepends the 32-byte frame header to an encoded payload."""
+    if frame_id is None:
+        frame_id = allocate_frame_id()
+    header = struct.pack(FRAME_HEADER_FORMAT, FRAME_MAGIC, FRAME_PROTOCOL_VERSION,
+                         pixel_format, encoding, scale, flags, 0, x, y, w, h,
+                         len(payload), frame_id, zlib.crc32(payload) & 0xFFFFFFFF)
+    return header + payload
+
+def parse_frame_header(data):
+    """Parses and validates a frame header exactly as validateFrameHeader() on the ESP32 does.
+
+    Returns a dict of header fields; raises ValueError with the firmware's reason string.
+    """
+    if len(data) < FRAME_HEADER_SIZE:
+        raise ValueError("short")
+    (magic, version, pixel_format, encoding, scale, flags, reserved1,
+     x, y, w, h, payload_len, frame_id, crc32) = struct.unpack_from(FRAME_HEADER_FORMAT, data)
+    if magic != FRAME_MAGIC:
+        raise ValueError("magic")
+    if version != FRAME_PROTOCOL_VERSION:
+        raise ValueError("version")
+    if reserved1 or flags & ~FRAME_KNOWN_FLAGS:
+        raise ValueError("reserved")
+    factor = (scale & 0x07) or 1
+    if scale & ~(0x07 | SCALE_BILINEAR) or factor not in SCALE_FACTORS:
+        raise ValueError("scale")
+    if factor > 1 and (pixel_format != PIXFMT_RGB565 or encoding != ENC_RAW or flags):
+        raise ValueError("scale")
+    if pixel_format > PIXFMT_PAL4:
+        raise ValueError("format")
+    if flags & (FRAME_FLAG_CONTINUATION | FRAME_FLAG_CREDIT) and (pixel_format != PIXFMT_RGB565 or encoding != ENC_RAW):
+        raise ValueError("flags")
+    if pixel_format != PIXFMT_RGB565 and encoding != ENC_RAW:
+        raise ValueError("format")
+    if w == 0 or h == 0:
+        raise ValueError("empty")
+    if x + w > IMAGE_WIDTH or y + h > IMAGE_HEIGHT:
+        raise ValueError("geometry")
+    if encoding == ENC_RAW:
+        if pixel_format == PIXFMT_RGB565:
+            if payload_len != -(-w // factor) * -(-h // factor) * 2:
+                raise ValueError("length")
+        else:
+            max_entries = 256 if pixel_format == PIXFMT_PAL8 else 16
+            index_bytes = (w if pixel_format == PIXFMT_PAL8 else (w + 1) // 2) * h
+            if not (2 + 2 + index_bytes <= payload_len <= 2 + max_entries * 2 + index_bytes):
+                raise ValueError("length")
+    elif encoding == ENC_TILES:
+        if payload_len == 0 or payload_len > w * h * (2 + struct.calcsize(TILE_HEADER_FORMAT)):
+            raise ValueError("length")
+    elif encoding == ENC_RLE:
+        if payload_len == 0 or payload_len > w * h * 2 + (w * h + 127) // 128:
+            raise ValueError("length")
+    elif encoding == ENC_JPEG:
+        if payload_len == 0 or payload_len > MAX_JPEG_BYTES:
+            raise ValueError("length")
+    else:
+        raise ValueError("encoding")
+    return {"format": pixel_format, "encoding": encoding, "flags": flags, "scale": scale,
+            "x": x, "y": y, "w": w, "h": h,
+            "payload_len": payload_len, "frame_id": frame_id, "crc32": crc32}
+
+def encode_dirty_tiles(previous, current, tile_size=TILE_SIZE):
+    """Diffs two (H, W) uint16 RGB565 frames and packs the changed tiles.
+
+    Returns (payload, (x, y, w, h) bounding box, tile_count); payload is b'' if nothing changed.
+    """
+    height, width = current.shape
+    tiles_y = -(-height // tile_size)
+    tiles_x = -(-width // tile_size)
+
+    # Pad to whole tiles so the per-tile "any pixel changed" test is one reshape.
+    changed = np.zeros((tiles_y * tile_size, tiles_x * tile_size), dtype=bool)
+    changed[:height, :width] = previous != current
+    dirty = changed.reshape(tiles_y, tile_size, tiles_x, tile_size).any(axis=(1, 3))
+
+    rows, cols = np.nonzero(dirty)
+    if len(rows) == 0:
+        return b'', (0, 0, 0, 0), 0
+
+    le_pixels = current.astype('<u2')
+    parts = []
+    for ty, tx in zip(rows, cols):
+        x, y = int(tx) * tile_size, int(ty) * tile_size
+        w, h = min(tile_size, width - x), min(tile_size, height - y)
+        parts.append(struct.pack(TILE_HEADER_FORMAT, x, y, w, h))
+        parts.append(le_pixels[y:y + h, x:x + w].tobytes())
+
+    x0, y0 = int(cols.min()) * tile_size, int(rows.min()) * tile_size
+    x1 = min(width, (int(cols.max()) + 1) * tile_size)
+    y1 = min(height, (int(rows.max()) + 1) * tile_size)
+    return b''.join(parts), (x0, y0, x1 - x0, y1 - y0), len(rows)
+
+def encode_rle(pixels):
+    """PackBits-style RLE over 16-bit pixels, matching drawRleRows() on the ESP32.
+
+    Control byte 0x00-0x7F: that many + 1 literal pixels follow.
+    Control byte 0x80-0xFF: the following pixel repeats (c - 0x80 + 2) times.
+
+    The same encoder is copied in USB_Stream_GenAI_Image/gemini_image_sender_final_sanitised.py, as each script runs
+    standalone: keep both copies in step with each other and with drawRleRows() in the sketches.
+    """
+    flat = np.ascontiguousarray(pixels, dtype='<u2').ravel()
+    le = flat.tobytes()
+    count = len(flat)
+    starts = np.concatenate(([0], np.flatnonzero(flat[1:] != flat[:-1]) + 1))
+    lengths = np.diff(np.concatenate((starts, [count])))
+
+    out = bytearray()
+
+    def flush_literals(begin, end):
+        while begin < end:
+            n = min(128, end - begin)
+            out.append(n - 1)
+            out.extend(le[begin * 2:(begin + n) * 2])
+            begin += n
+
+    literal_start = None
+    for start, length in zip(starts.tolist(), lengths.tolist()):
+        if length == 1:
+            if literal_start is None:
+                literal_start = start
+            continue
+        if literal_start is not None:
+            flush_literals(literal_start, start)
+            literal_start = None
+        while length >= 2:
+            n = min(129, length)
+            out.append(0x80 + n - 2)
+            out += le[start * 2:start * 2 + 2]
+            start += n
+            length -= n
+        if length == 1:
+            literal_start = start
+    if literal_start is not None:
+        flush_literals(literal_start, count)
+    return bytes(out)
+
+def cache_key(raw_data, mode):
+    """64-bit content key of a 320x170 RGB565 frame for the ESP32's flash cache.
+
+    The transfer mode is part of the key: a JPEG frame is cached as the ESP32
+    decoded it, which differs from the same image sent losslessly.
+    """
+    return int.from_bytes(hashlib.sha256(mode.encode('utf-8') + raw_data).digest()[:8], 'little')
+
+def read_line(sock):
+    """Reads one newline-terminated status line from the ESP32."""
+    line = bytearray()
+    while not line.endswith(b"\n"):
+        chunk = sock.recv(1)
+        if not chunk:
+            break
+        line += chunk
+    return line.decode('utf-8', errors='replace').strip()
+
+
+def encode_palettized(pil_image, colors=256):
+    """Quantizes to a 256- or 16-entry palette for PIXFMT_PAL8 / PIXFMT_PAL4.
+
+    Payload: uint16 entry count, the entries as RGB565, then one index byte per
+    pixel (PAL8) or two pixels per byte, high nibble first (PAL4).
+    Returns (payload, pixel_format).
+    """
+    if pil_image.size != (IMAGE_WIDTH, IMAGE_HEIGHT):
+        pil_image = pil_image.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
+    quantized = pil_image.convert("RGB").quantize(colors=colors, method=Image.Quantize.MEDIANCUT)
+    indices = np.array(quantized, dtype=np.uint8)
+    entries = int(indices.max()) + 1
+
+    rgb = np.array(quantized.getpalette()[:entries * 3], dtype=np.uint16).reshape(-1, 3)
+    palette = ((rgb[:, 0] >> 3) << 11) | ((rgb[:, 1] >> 2) << 5) | (rgb[:, 2] >> 3)
+
+    if colors > 16:
+        pixel_format, index_bytes = PIXFMT_PAL8, indices.tobytes()
+    else:
+        if indices.shape[1] % 2:
+            indices = np.pad(indices, ((0, 0), (0, 1)))
+        pixel_format = PIXFMT_PAL4
+        index_bytes = ((indices[:, 0::2] << 4) | indices[:, 1::2]).astype(np.uint8).tobytes()
+    payload = struct.pack('<H', entries) + palette.astype('<u2').tobytes() + index_bytes
+    return payload, pixel_format
+
+def expand_palettized(payload, pixel_format, w=IMAGE_WIDTH, h=IMAGE_HEIGHT):
+    """Host mirror of drawIndexedRows(): palette payload back to (h, w) RGB565."""
+    entries = struct.unpack_from('<H', payload)[0]
+    lut = np.zeros(256, dtype=np.uint16)
+    lut[:entries] = np.frombuffer(payload, dtype='<u2', count=entries, offset=2)
+    index_data = np.frombuffer(payload, dtype=np.uint8, offset=2 + entries * 2)
+    if pixel_format == PIXFMT_PAL8:
+        indices = index_data.reshape(h, w)
+    else:
+        packed = index_data.reshape(h, (w + 1) // 2)
+        indices = np.empty((h, packed.shape[1] * 2), dtype=np.uint8)
+        indices[:, 0::2] = packed >> 4
+        indices[:, 1::2] = packed & 0x0F
+        indices = indices[:, :w]
+    return lut[indices]
+
+def encode_jpeg(pil_image, quality=JPEG_QUALITY):
+    """Resizes to the panel and re-encodes as baseline JPEG for TJpg_Decoder on the ESP32.
+
+    The API's JPEG cannot be forwarded byte for byte: it is 16:9 at several times
+    the panel resolution and TJpg_Decoder only scales by powers of two.
+    """
+    if pil_image.size != (IMAGE_WIDTH, IMAGE_HEIGHT):
+        pil_image = pil_image.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
+    buffer = io.BytesIO()
+    pil_image.convert("RGB").save(buffer, format="JPEG", quality=quality, optimize=True, progressive=False)
+    return buffer.getvalue()
+
+
+# -----------------------------------------------------------------------------
+# *** LOW-RESOLUTION FRAMES ***
+# -----------------------------------------------------------------------------
+def scale_byte(factor, bilinear):
+    """The header's scale field for an upscale factor and filter."""
+    return 0 if factor == 1 else factor | (SCALE_BILINEAR if bilinear else 0)
+
+def scaled_frame_bytes(factor, w=IMAGE_WIDTH, h=IMAGE_HEIGHT):
+    return -(-w // factor) * -(-h // factor) * 2
+
+def downscale_for_transfer(pil_image, factor):
+    """Area-averages the image to the source size of a factor-f frame, as (h, w) RGB565."""
+    if pil_image.size != (IMAGE_WIDTH, IMAGE_HEIGHT):
+        pil_image = pil_image.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
+    size = (-(-IMAGE_WIDTH // factor), -(-IMAGE_HEIGHT // factor))
+    source = pil_image.convert("RGB").resize(size, Image.Resampling.BOX)
+    return to_rgb565(source)
+
+def blend_rgb565(a, b, weight):
+    """Mixes RGB565 arrays, weight/32 of b; bit-identical to blend565() on the ESP32."""
+    wa = (a.astype(np.uint32) | (a.astype(np.uint32) << 16)) & 0x07E0F81F
+    wb = (b.astype(np.uint32) | (b.astype(np.uint32) << 16)) & 0x07E0F81F
+    mix = ((wa * (32 - weight) + wb * weight) >> 5) & 0x07E0F81F
+    return (mix | (mix >> 16)).astype(np.uint16)
+
+def scale_neighbours(n_out, n_source, factor):
+    """Per output index: source pixel, blend neighbour and its weight in 32nds (scaleNeighbour())."""
+    i = np.arange(n_out)
+    d = 2 * (i % factor) + 1 - factor
+    nearest = i // factor
+    neighbour = np.clip(nearest + np.where(d < 0, -1, 1), 0, n_source - 1)
+    return nearest, neighbour, (np.abs(d) * 16 // factor).astype(np.uint32)
+
+def upscale_rgb565(source, factor, w=IMAGE_WIDTH, h=IMAGE_HEIGHT, bilinear=True):
+    """Mirror of the ESP32's Upscaler: the (h, w) frame it draws from an (h/f, w/f) source."""
+    source_h, source_w = source.shape
+    kx, nx, wx = scale_neighbours(w, source_w, factor)
+    ky, ny, wy = scale_neighbours(h, source_h, factor)
+    if not bilinear:
+        return source[ky][:, kx]
+    rows = blend_rgb565(source[:, kx], source[:, nx], wx[None, :])
+    return blend_rgb565(rows[ky], rows[ny], wy[:, None])
+
+def choose_scale(session, frame_bytes):
+    """Upscale factor for a frame of frame_bytes on this session's link.
+
+    1 while the frame fits SCALE_TIME_BUDGET at the measured throughput (or none
+    has been measured yet); else the smallest factor whose source fits, else the largest.
+    """
+    if session.throughput is None or frame_bytes / session.throughput <= SCALE_TIME_BUDGET:
+        return 1
+    for factor in SCALE_FACTORS[1:]:
+        if scaled_frame_bytes(factor) / session.throughput <= SCALE_TIME_BUDGET:
+            return factor
+    return SCALE_FACTORS[-1]
+
+
+class ImageSession:
+    """Keep-alive connection to the ESP32 Image Server (8080).
+
+    Many frames travel back to back over one connection, each answered with
+    "OK <id>", so the TCP handshake and slow start are paid once rather than
+    per frame. Raw RGB565 frames survive dropped connections: the session
+    reconnects, asks which row the ESP32 reached and sends only the rest.
+    """
+
+    def __init__(self, host=None, port=None):
+        self.host = host
+        self.port = port
+        self.sock = None
+        self.connects = 0
+        self.frames_acked = 0
+        self.bytes_sent = 0
+        self.credit_starved = 0.0  # seconds spent holding rows but no credit to send them
+        self.cache_hits = 0
+        self.cache_misses = 0
+        self.throughput = None  # bytes/s from send to ack, smoothed over frames of SCALE_MIN_SAMPLE_BYTES or more
+        # Last frame this display acknowledged, as (H, W) RGB565; delta frames are diffed against it.
+        self.last_acked_frame = None
+
+    def address(self):
+        return (self.host or ESP32_IP_ADDRESS, self.port or ESP32_IMAGE_PORT)
+
+    def is_alive(self):
+        """False if there is no socket or the ESP32 has closed it (e.g. idle timeout)."""
+        if self.sock is None:
+            return False
+        readable, _, _ = select.select([self.sock], [], [], 0)
+        if not readable:
+            return True
+        try:
+            return self.sock.recv(1, socket.MSG_PEEK) != b''
+        except OSError:
+            return False
+
+    def connect(self):
+        self.close()
+        host, port = self.address()
+        print(f"[CLIENT] Connecting to ESP32 Image Server at {host}:{port}...")
         s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        s.settimeout(5) 
-        s.connect((ESP32_IP_ADDRESS, ESP32_IMAGE_PORT))
-        print("[CLIENT] Connection successful! Streaming image data...")
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        s.settimeout(5)
+        try:
+            s.connect((host, port))
+        except OSError:
+            s.close()
+            raise
+        self.sock = s
+        self.connects += 1
+
+    def close(self):
+        if self.sock is not None:
+            self.sock.close()
+            self.sock = None
+
+    def query_cache(self, key, frame_id):
+        """Asks the ESP32 to redraw the image with this content key from its flash cache.
+
+        Returns True on "HIT". On "MISS" or any error returns False, and the
+        caller sends the frame as usual with the same frame_id.
+        """
+        try:
+            if not self.is_alive():
+                self.connect()
+            self.sock.settimeout(ACK_TIMEOUT)
+            self.sock.sendall(struct.pack(CACHE_QUERY_FORMAT, CACHE_MAGIC, frame_id, key))
+            reply = read_line(self.sock)
+        except OSError as e:
+            print(f"--- NETWORK ERROR --- Cache query failed: {e}")
+            self.close()
+            return False
+        if reply == f"HIT {frame_id}":
+            self.cache_hits += 1
+            print(f"[CACHE] Hit for {key:016x}: redrawn from the ESP32's flash, no payload sent "
+                  f"({self.cache_hits} hits, {self.cache_misses} misses).")
+            return True
+        self.cache_misses += 1
+        if reply != f"MISS {frame_id}":
+            print(f"--- NETWORK ERROR --- Unexpected cache reply '{reply}'.")
+            self.close()
+        return False
+
+    def send_with_credit(self, frame, frame_id, row_bytes):
+        """Sends a FRAME_FLAG_CREDIT frame, releasing rows only as the ESP32 grants credit.
+
+        Returns None once every row is sent, or the first non-CREDIT line (a
+        rejection) so the caller can treat it as the frame's ack.
+        """
+        self.sock.sendall(frame[:FRAME_HEADER_SIZE])
+        offset, credit, grants, starved = FRAME_HEADER_SIZE, 0, 0, 0.0
+        start = time.perf_counter()
+        while offset < len(frame):
+            if credit == 0:
+                wait_start = time.perf_counter()
+                line = read_line(self.sock)
+                starved += time.perf_counter() - wait_start
+                reply = line.split()
+                if len(reply) != 3 or reply[0] != "CREDIT" or reply[1] != str(frame_id):
+                    return line
+                credit, grants = int(reply[2]), grants + 1
+            chunk = frame[offset:offset + credit * row_bytes]
+            self.sock.sendall(chunk)
+            offset += len(chunk)
+            credit = 0
+        self.credit_starved += starved
+        elapsed = time.perf_counter() - start
+        print(f"[CREDIT] Frame {frame_id}: {grants} grants, starved of credit for {1000 * starved:.1f} ms "
+              f"of {1000 * elapsed:.1f} ms ({100 * starved / elapsed:.0f}%).")
+        return None
+
+    def send_frame(self, payload, x=0, y=0, w=IMAGE_WIDTH, h=IMAGE_HEIGHT, encoding=ENC_RAW,
+                   pixel_format=PIXFMT_RGB565, frame_id=None, scale=0):
+        """Sends one framed image and waits for its ack. Returns True if acknowledged."""
+        if frame_id is None:
+            frame_id = allocate_frame_id()
+        resumable = encoding == ENC_RAW and pixel_format == PIXFMT_RGB565 and not scale
+        attempts = 1 + (MAX_RESUME_ATTEMPTS if resumable else 0)
+        credit_flag = FRAME_FLAG_CREDIT if resumable and USE_CREDIT_FLOW else 0
+
+        for attempt in range(attempts):
+            try:
+                reconnected = not self.is_alive()
+                if reconnected:
+                    self.connect()
+                self.sock.settimeout(5)
+
+                frame = encode_frame(payload, x, y, w, h, pixel_format=pixel_format,
+                                     encoding=encoding, frame_id=frame_id, flags=credit_flag, scale=scale)
+                if attempt > 0:
+                    # Ask where the interrupted transfer stopped; -1 means start over.
+                    self.sock.sendall(struct.pack(RESUME_QUERY_FORMAT, RESUME_MAGIC, frame_id))
+                    reply = read_line(self.sock).split()
+                    if len(reply) != 3 or reply[0] != "RESUME":
+                        raise ConnectionError(f"unexpected resume reply {reply}")
+                    next_row = int(reply[2])
+                    if next_row >= y + h:
+                        print(f"[CLIENT] Frame {frame_id} was already complete on the ESP32.")
+                        self.frames_acked += 1
+                        return True
+                    if next_row >= y:
+                        print(f"[CLIENT] Resuming frame {frame_id} at row {next_row} "
+                              f"({h - (next_row - y)} of {h} rows left).")
+                        offset = (next_row - y) * w * 2
+                        frame = encode_frame(payload[offset:], x, next_row, w, y + h - next_row,
+                                             frame_id=frame_id, flags=FRAME_FLAG_CONTINUATION | credit_flag)
+
+                print(f"[CLIENT] Streaming frame {frame_id} ({len(frame)} bytes) on "
+                      f"{'new' if reconnected else 'open'} session...")
+                sent_at = time.perf_counter()
+                ack = None
+                if credit_flag:
+                    self.sock.settimeout(ACK_TIMEOUT)
+                    ack = self.send_with_credit(frame, frame_id, w * 2)
+                else:
+                    self.sock.sendall(frame)
+                self.bytes_sent += len(frame)
+
+                self.sock.settimeout(ACK_TIMEOUT)
+                if ack is None:
+                    ack = read_line(self.sock)
+                if ack == f"OK {frame_id}":
+                    print("[CLIENT] Image stream complete. Frame acknowledged.")
+                    self.frames_acked += 1
+                    if len(frame) >= SCALE_MIN_SAMPLE_BYTES:
+                        rate = len(frame) / (time.perf_counter() - sent_at)
+                        self.throughput = rate if self.throughput is None else (self.throughput + rate) / 2
+                    return True
+                if ack and not ack.endswith(" short"):
+                    # Rejected rather than interrupted: resending the same bytes will not help.
+                    # The ESP32 drops the connection after a rejected header.
+                    print(f"--- NETWORK ERROR --- Frame {frame_id} rejected by ESP32: '{ack}'")
+                    self.close()
+                    return False
+                print(f"--- NETWORK ERROR --- Frame {frame_id} interrupted ('{ack}').")
+
+            except socket.timeout:
+                print("--- NETWORK ERROR --- Connection timed out.")
+            except ConnectionRefusedError:
+                print("--- NETWORK ERROR --- Connection refused. Is ESP32 server running?")
+            except Exception as e:
+                print(f"An unexpected error occurred during image stream: {e}")
+
+            self.close()
+            if attempt + 1 < attempts:
+                time.sleep(RESUME_RETRY_DELAY)
+        return False
 
-        s.sendall(raw_data)
-        
-        s.shutdown(socket.SHUT_RDWR)
-        s.close()
-        print("[CLIENT] Image stream complete. Socket closed.")
-        
-    except socket.timeout:
-        print("--- NETWORK ERROR --- Connection timed out.")
-    except ConnectionRefusedError:
-        print("--- NETWORK ERROR --- Connection refused. Is ESP32 server running?")
-    except Exception as e:
-        print(f"An unexpected error occurred during image stream: {e}")
+
+# One session is shared by every send in the polling loop.
+_image_session = ImageSession()
+
+def send_image_tcp(raw_data, x=0, y=0, w=IMAGE_WIDTH, h=IMAGE_HEIGHT, encoding=ENC_RAW,
+                   pixel_format=PIXFMT_RGB565):
+    """Sends one framed image over the shared keep-alive session and waits for the ack.
+
+    Returns True if the ESP32 acknowledged the frame.
+    """
+    return _image_session.send_frame(raw_data, x, y, w, h, encoding=encoding, pixel_format=pixel_format)
+
+
+def multicast_frame(raw_data, expected_displays=None):
+    """Sends one full 320x170 RGB565 frame to every display in the multicast group.
+
+    Rows go out once for all displays; only ranges that some display NACKs are
+    sent again. Host bandwidth therefore does not grow with the number of
+    displays. Returns a dict of statistics.
+    """
+    frame_id = allocate_frame_id()
+    row_bytes = IMAGE_WIDTH * 2
+    stats = {"frame_id": frame_id, "bytes_sent": 0, "repair_bytes": 0, "repair_rounds": 0,
+             "acked_by": set(), "nacked_by": set()}
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, MULTICAST_TTL)
+    if MULTICAST_INTERFACE:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(MULTICAST_INTERFACE))
+    sock.bind(('', 0))  # NACKs and ACKs come back to this port
+    group = (MULTICAST_GROUP, MULTICAST_PORT)
+
+    def send_rows(first, count, repair=False):
+        end = first + count
+        while first < end:
+            n = min(MCAST_ROWS_PER_PACKET, end - first)
+            packet = struct.pack(MCAST_HEADER_FORMAT, MCAST_MAGIC, MCAST_DATA, 0, first, n, IMAGE_HEIGHT, frame_id)
+            packet += raw_data[first * row_bytes:(first + n) * row_bytes]
+            sock.sendto(packet, group)
+            stats["bytes_sent"] += len(packet)
+            if repair:
+                stats["repair_bytes"] += len(packet)
+            first += n
+            time.sleep(MCAST_PACKET_INTERVAL)
+
+    start = time.time()
+    try:
+        send_rows(0, IMAGE_HEIGHT)
+        for round_number in range(MCAST_MAX_REPAIR_ROUNDS + 1):
+            sock.sendto(struct.pack(MCAST_HEADER_FORMAT, MCAST_MAGIC, MCAST_END, 0, 0, 0, IMAGE_HEIGHT, frame_id), group)
+
+            # Merge every display's missing ranges, so each repaired row is sent once.
+            missing = set()
+            deadline = time.time() + MCAST_NACK_WINDOW
+            while time.time() < deadline:
+                readable, _, _ = select.select([sock], [], [], max(0, deadline - time.time()))
+                if not readable:
+                    break
+                reply, (address, _) = sock.recvfrom(2048)
+                if len(reply) < 8 or struct.unpack_from('<I', reply, 4)[0] != frame_id:
+                    continue
+                if reply[:4] == MCAST_ACK_MAGIC:
+                    stats["acked_by"].add(address)
+                elif reply[:4] == MCAST_NACK_MAGIC and len(reply) >= 10:
+                    stats["nacked_by"].add(address)
+                    ranges = struct.unpack_from('<H', reply, 8)[0]
+                    for i in range(min(ranges, (len(reply) - 10) // 4)):
+                        first, count = struct.unpack_from('<HH', reply, 10 + 4 * i)
+                        missing.update(range(first, min(first + count, IMAGE_HEIGHT)))
+
+            if expected_displays is not None and len(stats["acked_by"]) >= expected_displays:
+                break
+            if not missing:
+                break
+            stats["repair_rounds"] += 1
+            rows = sorted(missing)
+            print(f"[MULTICAST] Repair round {round_number + 1}: {len(rows)} rows requested.")
+            run_start = rows[0]
+            for previous, row in zip(rows, rows[1:] + [None]):
+                if row != previous + 1:
+                    send_rows(run_start, previous + 1 - run_start, repair=True)
+                    run_start = row
+    finally:
+        sock.close()
+
+    stats["seconds"] = time.time() - start
+    print(f"[MULTICAST] Frame {frame_id}: {stats['bytes_sent']} bytes sent "
+          f"({stats['repair_bytes']} in {stats['repair_rounds']} repair rounds) in {stats['seconds']:.2f} s, "
+          f"acknowledged by {len(stats['acked_by'])} display(s).")
+    return stats
+
+
+def send_image_delta(raw_data, session=None, frame_id=None, pil_image=None):
+    """Sends the smallest encoding of a full 320x170 frame.
+
+    Candidates are the 16x16 tiles that differ from the last acknowledged frame,
+    the RLE-compressed frame and the raw frame. Without an acknowledged frame
+    only RLE and raw are considered. Given pil_image, a link too slow for the
+    smallest of them within SCALE_TIME_BUDGET gets a 2x or 4x source instead.
+    """
+    session = session or _image_session
+    current = np.frombuffer(raw_data, dtype='<u2').reshape(IMAGE_HEIGHT, IMAGE_WIDTH)
+
+    rle_payload = encode_rle(current)
+    candidates = [(len(raw_data), raw_data, (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT), ENC_RAW, "raw"),
+                  (len(rle_payload), rle_payload, (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT), ENC_RLE, "RLE")]
+
+    if session.last_acked_frame is not None:
+        payload, box, tile_count = encode_dirty_tiles(session.last_acked_frame, current)
+        if not payload:
+            print("[DELTA] Frame identical to the displayed one. Nothing to send.")
+            return True
+        candidates.append((len(payload), payload, box, ENC_TILES, f"{tile_count} dirty tiles"))
+
+    size, payload, (x, y, w, h), encoding, label = min(candidates, key=lambda c: c[0])
+    factor = choose_scale(session, size) if pil_image is not None and USE_ADAPTIVE_SCALE else 1
+    if factor > 1:
+        return send_image_scaled(pil_image, factor, session, frame_id)
+    print(f"[ENCODING] Sending {label}: {size} bytes ({100 * size / len(raw_data):.1f}% of a raw frame).")
+    ok = session.send_frame(payload, x, y, w, h, encoding=encoding, frame_id=frame_id)
+    # A failed frame leaves the panel in an unknown state: force a full resend next time.
+    session.last_acked_frame = current if ok else None
+    return ok
+
+
+def send_image_scaled(pil_image, factor, session=None, frame_id=None):
+    """Sends a 1/factor-size source that the ESP32 upscales with SCALE_FILTER."""
+    session = session or _image_session
+    bilinear = SCALE_FILTER == "bilinear"
+    source = downscale_for_transfer(pil_image, factor)
+    payload = source.astype('<u2').tobytes()
+    throughput = f"{session.throughput / 1024:.0f} KB/s" if session.throughput else "unmeasured"
+    print(f"[SCALE] Link at {throughput}: sending a {source.shape[1]}x{source.shape[0]} source for "
+          f"{factor}x {SCALE_FILTER} upscale, {len(payload)} bytes ({100 * len(payload) / EXPECTED_SIZE:.1f}% of a raw frame).")
+    ok = session.send_frame(payload, encoding=ENC_RAW, frame_id=frame_id, scale=scale_byte(factor, bilinear))
+    # The ESP32's upscale is reproduced exactly, so the next delta can build on it.
+    session.last_acked_frame = upscale_rgb565(source, factor, bilinear=bilinear) if ok else None
+    return ok
+
+
+def send_image_jpeg(pil_image, session=None, frame_id=None):
+    """Sends the image as a JPEG frame, lowering the quality until it fits MAX_JPEG_BYTES."""
+    session = session or _image_session
+    quality = JPEG_QUALITY
+    jpeg_data = encode_jpeg(pil_image, quality)
+    while len(jpeg_data) > MAX_JPEG_BYTES and quality > 30:
+        quality -= 10
+        jpeg_data = encode_jpeg(pil_image, quality)
+    print(f"[ENCODING] Sending JPEG (quality {quality}): {len(jpeg_data)} bytes "
+          f"({100 * len(jpeg_data) / EXPECTED_SIZE:.1f}% of a raw frame).")
+    ok = session.send_frame(jpeg_data, encoding=ENC_JPEG, frame_id=frame_id)
+    # The ESP32's decoder output is not bit-identical to ours, so the next delta must be a full frame.
+    session.last_acked_frame = None
+    return ok
+
+
+def send_image_palette(pil_image, colors, session=None, frame_id=None):
+    """Sends the image as a 256- or 16-colour palettized frame."""
+    session = session or _image_session
+    payload, pixel_format = encode_palettized(pil_image, colors)
+    print(f"[ENCODING] Sending {colors}-colour palette: {len(payload)} bytes "
+          f"({100 * len(payload) / EXPECTED_SIZE:.1f}% of a raw frame).")
+    frame_ok = session.send_frame(payload, encoding=ENC_RAW, pixel_format=pixel_format, frame_id=frame_id)
+    session.last_acked_frame = expand_palettized(payload, pixel_format) if frame_ok else None
+    return frame_ok
+
+
+def send_image(pil_image, session=None):
+    """Sends a generated image to one display using TRANSFER_MODE. Returns True if acknowledged.
+
+    With USE_DEVICE_CACHE the display is first asked for the image by content
+    key, and the image itself is sent only if the display has not cached it.
+    """
+    session = session or _image_session
+    raw_data = convert_to_rgb565_raw(pil_image)
+    frame_id = None
+    if USE_DEVICE_CACHE:
+        frame_id = allocate_frame_id()
+        if session.query_cache(cache_key(raw_data, TRANSFER_MODE), frame_id):
+            # Lossless frames are cached exactly as sent, so they stay a valid delta baseline.
+            session.last_acked_frame = (np.frombuffer(raw_data, dtype='<u2').reshape(IMAGE_HEIGHT, IMAGE_WIDTH)
+                                        if TRANSFER_MODE == "lossless" else None)
+            return True
+
+    if TRANSFER_MODE == "jpeg":
+        return send_image_jpeg(pil_image, session, frame_id)
+    if TRANSFER_MODE == "palette256":
+        return send_image_palette(pil_image, 256, session, frame_id)
+    if TRANSFER_MODE == "palette16":
+        return send_image_palette(pil_image, 16, session, frame_id)
+    return send_image_delta(raw_data, session, frame_id, pil_image)
+
+
+# -----------------------------------------------------------------------------
+# *** REGION UPDATES ***
+# -----------------------------------------------------------------------------
+# A frame's x, y, w, h may be any rectangle on the panel: small overlays (a
+# sensor readout, a clock, a status badge) cost bytes in proportion to their area.
+BADGE_SIZE = (96, 20)
+BADGE_BACKGROUND = (16, 16, 16)
+BADGE_FOREGROUND = (255, 255, 255)
+
+def render_badge(text, size=BADGE_SIZE):
+    """A small text badge to draw over the current image."""
+    badge = Image.new("RGB", size, BADGE_BACKGROUND)
+    draw = ImageDraw.Draw(badge)
+    font = ImageFont.load_default()
+    left, top, right, bottom = draw.textbbox((0, 0), text, font=font)
+    draw.text(((size[0] - (right - left)) // 2 - left, (size[1] - (bottom - top)) // 2 - top),
+              text, fill=BADGE_FOREGROUND, font=font)
+    return badge
+
+def send_region(pil_image, x, y, session=None):
+    """Draws pil_image at (x, y), leaving the rest of the panel as it is.
+
+    The region goes as raw or RLE, whichever is smaller. Returns True if acknowledged.
+    """
+    session = session or _image_session
+    w, h = pil_image.size
+    if x + w > IMAGE_WIDTH or y + h > IMAGE_HEIGHT:
+        raise ValueError(f"{w}x{h} region at ({x},{y}) does not fit the {IMAGE_WIDTH}x{IMAGE_HEIGHT} panel")
+    pixels = to_rgb565(pil_image)
+    raw = pixels.astype('<u2').tobytes()
+    rle = encode_rle(pixels)
+    payload, encoding, label = (rle, ENC_RLE, "RLE") if len(rle) < len(raw) else (raw, ENC_RAW, "raw")
+    print(f"[REGION] {w}x{h} at ({x},{y}) as {label}: {len(payload)} bytes "
+          f"({100 * len(payload) / EXPECTED_SIZE:.1f}% of a full frame).")
+    ok = session.send_frame(payload, x, y, w, h, encoding=encoding)
+    # Keep the delta baseline in step with the panel.
+    if session.last_acked_frame is not None:
+        if ok:
+            session.last_acked_frame = session.last_acked_frame.copy()
+            session.last_acked_frame[y:y + h, x:x + w] = pixels
+        else:
+            session.last_acked_frame = None
+    return ok
+
+def run_clock(seconds, session=None):
+    """Redraws a clock badge in the top-right corner once a second."""
+    x, y = IMAGE_WIDTH - BADGE_SIZE[0] - 4, 4
+    for _ in range(int(seconds)):
+        start = time.perf_counter()
+        if not send_region(render_badge(time.strftime("%H:%M:%S")), x, y, session):
+            break
+        time.sleep(max(0.0, 1.0 - (time.perf_counter() - start)))
+
+
+# -----------------------------------------------------------------------------
+# *** ANIMATION STREAMING ***
+# -----------------------------------------------------------------------------
+def make_animation_frames(pil_image, count):
+    """Slow pan and zoom ("Ken Burns") across one image, as panel-sized frames."""
+    source = pil_image.convert("RGB").resize((IMAGE_WIDTH * 2, IMAGE_HEIGHT * 2), Image.BILINEAR)
+    frames = []
+    for i in range(count):
+        t = i / max(1, count - 1)
+        zoom = 1.0 + 0.5 * t  # 1.0 shows the whole source, 1.5 two thirds of it
+        w, h = source.width / zoom, source.height / zoom
+        left, top = (source.width - w) * t, (source.height - h) * (1 - t)
+        box = (round(left), round(top), round(left + w), round(top + h))
+        frames.append(source.resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.BILINEAR, box=box))
+    return frames
+
+def encode_stream_frames(frames, mode=STREAM_ENCODING):
+    """Encodes every frame up front, so sending is never slower than the frame rate.
+
+    Returns a list of (payload, (x, y, w, h), encoding). In "delta" mode each frame
+    is the smaller of its RLE encoding and the tiles that differ from its predecessor.
+    """
+    encoded = []
+    previous = None
+    for frame in frames:
+        if mode == "jpeg":
+            encoded.append((encode_jpeg(frame), (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT), ENC_JPEG))
+            continue
+        current = np.frombuffer(convert_to_rgb565_raw(frame, DITHER_ANIMATION), dtype='<u2').reshape(IMAGE_HEIGHT, IMAGE_WIDTH)
+        best = (encode_rle(current), (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT), ENC_RLE)
+        if previous is not None:
+            payload, box, _ = encode_dirty_tiles(previous, current)
+            if not payload:
+                # Every frame must still arrive to keep the ESP32's schedule; resend one pixel.
+                payload = struct.pack(TILE_HEADER_FORMAT, 0, 0, 1, 1) + current[:1, :1].astype('<u2').tobytes()
+                box = (0, 0, 1, 1)
+            if len(payload) < len(best[0]):
+                best = (payload, box, ENC_TILES)
+        encoded.append(best)
+        previous = current
+    return encoded
+
+def stream_animation(encoded, fps=STREAM_FPS, session=None):
+    """Streams pre-encoded frames for presentation at a fixed rate.
+
+    Up to STREAM_MAX_IN_FLIGHT frames are on the wire ahead of their ack; the
+    ESP32 paces presentation itself and skips frames that arrive too late.
+    Returns the ESP32's "STREAM ..." summary fields, or None if the stream broke.
+    """
+    session = session or _image_session
+    period_us = int(1e6 / fps)
+    in_flight = {}  # frame id -> send time
+    latencies = []
+    late = failed = 0
+
+    def read_ack():
+        nonlocal late, failed
+        reply = read_line(session.sock).split()
+        if len(reply) < 2 or not reply[1].isdigit() or int(reply[1]) not in in_flight:
+            raise ConnectionError(f"unexpected stream reply {reply}")
+        latencies.append(time.perf_counter() - in_flight.pop(int(reply[1])))
+        if reply[0] == "ERR":
+            if reply[2:] == ["late"]:
+                late += 1
+            else:
+                failed += 1
+
+    try:
+        if not session.is_alive():
+            session.connect()
+        session.sock.settimeout(ACK_TIMEOUT)
+        session.sock.sendall(struct.pack(STREAM_CONTROL_FORMAT, STREAM_MAGIC, period_us))
+        print(f"[STREAM] Streaming {len(encoded)} frames at {fps} fps "
+              f"({sum(len(p) for p, _, _ in encoded) // max(1, len(encoded))} bytes per frame on average)...")
+        start = time.perf_counter()
+        for payload, (x, y, w, h), encoding in encoded:
+            while len(in_flight) >= STREAM_MAX_IN_FLIGHT:
+                read_ack()
+            frame_id = allocate_frame_id()
+            frame = encode_frame(payload, x, y, w, h, encoding=encoding, frame_id=frame_id)
+            in_flight[frame_id] = time.perf_counter()
+            session.sock.sendall(frame)
+            session.bytes_sent += len(frame)
+        while in_flight:
+            read_ack()
+        elapsed = time.perf_counter() - start
+
+        session.sock.sendall(struct.pack(STREAM_CONTROL_FORMAT, STREAM_MAGIC, 0))
+        reply = read_line(session.sock).split()
+    except (OSError, ConnectionError) as e:
+        print(f"--- NETWORK ERROR --- Stream interrupted: {e}")
+        session.close()
+        return None
+    if not reply or reply[0] != "STREAM":
+        print(f"--- NETWORK ERROR --- Unexpected stream summary {reply}")
+        return None
+
+    summary = dict(field.split("=", 1) for field in reply[1:])
+    session.frames_acked += len(encoded) - failed
+    # The panel now shows the last presented stream frame, which the host cannot name.
+    session.last_acked_frame = None
+    latencies.sort()
+    print(f"[STREAM] Host: {len(encoded)} frames in {elapsed:.2f} s ({len(encoded) / elapsed:.2f} fps sent), "
+          f"ack latency median {1000 * latencies[len(latencies) // 2]:.1f} ms, "
+          f"max {1000 * latencies[-1]:.1f} ms, {late} late, {failed} failed.")
+    print(f"[STREAM] ESP32: {summary.get('presented')} presented, {summary.get('dropped')} dropped, "
+          f"{summary.get('fps')} fps (target {fps}), jitter {summary.get('jitter_us')} us, "
+          f"worst lateness {summary.get('max_late_us')} us.")
+    return summary
 
 
 # -----------------------------------------------------------------------------
 # *** NEW SENSOR POLLING LOGIC ***
 # -----------------------------------------------------------------------------
-def poll_sensor_data():
-    """Connects to the ESP32 Sensor Server (8082) and requests data."""
-    print(f"\n[POLLING] Connecting to ESP32 Sensor Server at {ESP32_IP_ADDRESS}:{ESP32_SENSOR_PORT}...")
+def poll_sensor_data(host=None, port=None, command="GET_TEMP"):
+    """Connects to the ESP32 Sensor Server (8082) and requests data.
+
+    "GET_TEMP" returns the sensor reading; "GET_STATS" the frame cache statistics;
+    "GET_TIMING" the decode time of the last JPEG or palettized frame.
+    """
+    host = host or ESP32_IP_ADDRESS
+    port = port or ESP32_SENSOR_PORT
+    print(f"\n[POLLING] Connecting to ESP32 Sensor Server at {host}:{port}...")
     
     try:
         s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         s.settimeout(5) 
-        s.connect((ESP32_IP_ADDRESS, ESP32_SENSOR_PORT))
+        s.connect((host, port))
         print("[POLLING] Connection successful. Requesting data...")
 
         # Send a simple request command to the ESP32
-        s.sendall("GET_TEMP\n".encode('utf-8'))
+        s.sendall(f"{command}\n".encode('utf-8'))
 
         # Receive the response (sensor data)
         data = s.recv(1024).decode('utf-8').strip()
@@ -131,34 +1110,43 @@ def poll_sensor_data():
     
     return None
 
-def process_and_send_image(data):
-    """Parses sensor data, generates prompt, and initiates image stream."""
-    print(f"[PROCESSOR] Received sensor data: {data}")
-    
+def parse_temperature(data):
+    """Extracts the temperature from a sensor reply such as "temp=35.50C"."""
     try:
-        # Simple Parsing (Example: data = "temp=35.50C")
         temp_string = data.split('=')[1].replace('C', '')
-        temp_value = float(temp_string)
+        return float(temp_string)
     except Exception:
         print("[PROCESSOR] Could not parse temperature data. Using default temp 25.0C.")
-        temp_value = 25.0
+        return 25.0
 
-    # 1. GENERATE DYNAMIC PROMPT
+def build_prompt(temp_value, shown_temp=None):
+    """Maps a temperature onto the AI prompt.
+
+    The scene is chosen from temp_value; shown_temp (default temp_value) is the
+    figure written into the prompt, so callers can round it without changing the scene.
+    """
+    shown_temp = temp_value if shown_temp is None else shown_temp
     if temp_value > 30:
-        prompt = f"A dramatic, hot, desert landscape under a blazing sun with red and yellow tones. Current temperature is {temp_value:.2f}C."
-    elif temp_value < 20:
-        prompt = f"A serene, cold winter wonderland with thick snow and deep blue tones. Current temperature is {temp_value:.2f}C."
+        return f"A dramatic, hot, desert landscape under a blazing sun with red and yellow tones. Current temperature is {shown_temp:.2f}C."
+    if temp_value < 20:
+        return f"A serene, cold winter wonderland with thick snow and deep blue tones. Current temperature is {shown_temp:.2f}C."
+
+    decimal_part = temp_value - int(temp_value)
+    if decimal_part < 0.33:
+         mood = "A mild, contemplative forest scene at dawn with soft muted colors."
+    elif decimal_part < 0.66:
+         mood = "A pleasant, sunny meadow scene in the afternoon with cheerful green and yellow."
     else:
-        decimal_part = temp_value - int(temp_value)
-        if decimal_part < 0.33:
-             mood = "A mild, contemplative forest scene at dawn with soft muted colors."
-        elif decimal_part < 0.66:
-             mood = "A pleasant, sunny meadow scene in the afternoon with cheerful green and yellow."
-        else:
-             mood = "A slightly overcast, calm lake scene at dusk with atmospheric moody blue."
-             
-        prompt = f"{mood} Temperature is {temp_value:.2f}C, causing subtle changes in the environment."
+         mood = "A slightly overcast, calm lake scene at dusk with atmospheric moody blue."
+         
+    return f"{mood} Temperature is {shown_temp:.2f}C, causing subtle changes in the environment."
 
+def process_and_send_image(data):
+    """Parses sensor data, generates prompt, and initiates image stream."""
+    print(f"[PROCESSOR] Received sensor data: {data}")
+    
+    # 1. GENERATE DYNAMIC PROMPT
+    prompt = build_prompt(parse_temperature(data))
     print(f"[PROCESSOR] Generated AI Prompt: {prompt}")
 
     # 2. GENERATE IMAGE
@@ -167,15 +1155,253 @@ def process_and_send_image(data):
     if pil_image:
         # 3. CONVERT & SEND IMAGE BACK TO ESP32
         try:
-            raw_data_bytes = convert_to_rgb565_raw(pil_image)
-            send_image_tcp(raw_data_bytes)
+            if USE_MULTICAST:
+                multicast_frame(convert_to_rgb565_raw(pil_image))
+            else:
+                send_image(pil_image)
         except ValueError as e:
             print(f"FATAL ERROR during conversion: {e}. Aborting send.")
     
     print("-" * 50)
 
 
-if __name__ == "__main__":
+# -----------------------------------------------------------------------------
+# *** HOST-SIDE BENCHMARKS ***
+# -----------------------------------------------------------------------------
+REPO_DIR = os.path.dirname(os.path.abspath(__file__))
+SAMPLE_IMAGES = [
+    "summary.jpg",
+    "WiFi_Stream_Image/summary.jpg",
+    "USB_Stream_GenAI_Image/summary.jpg",
+    "USB_Stream_Image/DIYMORE_LCD_USB.jpg",
+    "Debugging_LCD_colour/Gemini_Generated_Image_320x240.png",
+    "USB_Stream_Image/myimage.raw",
+]
+
+def load_sample_image(path):
+    """Opens a bundled sample; .raw files are 320x170 little-endian RGB565."""
+    if path.endswith(".raw"):
+        with open(path, 'rb') as f:
+            pixels = np.frombuffer(f.read(), dtype='<u2').reshape(IMAGE_HEIGHT, IMAGE_WIDTH)
+        rgb = np.stack([(pixels >> 11) << 3, ((pixels >> 5) & 0x3F) << 2, (pixels & 0x1F) << 3], axis=-1)
+        return Image.fromarray(rgb.astype(np.uint8), "RGB")
+    return Image.open(path)
+
+class DeviceTimer:
+    """Sends benchmark frames to the ESP32 and reads back the decode time it measured.
+
+    The first frame that is not acknowledged marks the ESP32 unreachable, so an
+    offline benchmark costs one connection timeout rather than one per sample.
+    """
+    def __init__(self, session=None):
+        self.session = session or _image_session
+        self.reachable = True
+
+    def decode_ms(self, payload, **frame_args):
+        """Decode time in ms of this frame on the ESP32 ("GET_TIMING"), or None."""
+        if not self.reachable:
+            return None
+        frame_id = allocate_frame_id()
+        if not self.session.send_frame(payload, frame_id=frame_id, **frame_args):
+            self.reachable = False
+            return None
+        reply = (poll_sensor_data(command="GET_TIMING") or "").split()
+        if len(reply) != 5 or reply[0] != "TIMING" or reply[1] != str(frame_id):
+            return None
+        return int(reply[4]) / 1000
+
+def format_ms(ms, width):
+    return f"{'-':>{width}}" if ms is None else f"{ms:>{width}.2f}"
+
+def benchmark_jpeg():
+    """Per-frame JPEG size for the bundled samples, and TJpg_Decoder's decode time on the ESP32.
+
+    Each JPEG is sent as a frame and the ESP32's own measurement (decode plus
+    panel writes, as in its [TIMING] line) is read back; "-" if it is offline.
+    """
+    device = DeviceTimer()
+    print(f"{'sample':<58} {'raw':>7} {'RLE':>7} {'JPEG':>7} {'ESP32 decode ms':>16}")
+    for name in SAMPLE_IMAGES:
+        path = os.path.join(REPO_DIR, name)
+        if not os.path.exists(path):
+            continue
+        pil_image = load_sample_image(path)
+        raw = convert_to_rgb565_raw(pil_image)
+        rle = encode_rle(np.frombuffer(raw, dtype='<u2'))
+        jpeg_data = encode_jpeg(pil_image)
+        decode_ms = device.decode_ms(jpeg_data, encoding=ENC_JPEG)
+        print(f"{name:<58} {len(raw):>7} {len(rle):>7} {len(jpeg_data):>7} {format_ms(decode_ms, 16)}")
+    if not device.reachable:
+        print(f"ESP32 at {ESP32_IP_ADDRESS} not reachable; device decode times skipped.")
+
+def benchmark_palette():
+    """Palette quantize cost and wire size for the bundled samples, and LUT expansion time on the ESP32.
+
+    Each frame is sent and the ESP32's own "LUT expansion" time (the per-pixel
+    loop in drawIndexedRows(), without network or SPI) is read back; "-" if it is offline.
+    """
+    device = DeviceTimer()
+    print(f"{'sample':<58} {'colours':>7} {'bytes':>7} {'quantize ms':>12} {'ESP32 expand ms':>16}")
+    for name in SAMPLE_IMAGES:
+        path = os.path.join(REPO_DIR, name)
+        if not os.path.exists(path):
+            continue
+        pil_image = load_sample_image(path)
+        for colors in (256, 16):
+            start = time.perf_counter()
+            payload, pixel_format = encode_palettized(pil_image, colors)
+            quantize_ms = (time.perf_counter() - start) * 1000
+            expand_ms = device.decode_ms(payload, encoding=ENC_RAW, pixel_format=pixel_format)
+            print(f"{name:<58} {colors:>7} {len(payload):>7} {quantize_ms:>12.2f} {format_ms(expand_ms, 16)}")
+    if not device.reachable:
+        print(f"ESP32 at {ESP32_IP_ADDRESS} not reachable; device expansion times skipped.")
+
+def rgb565_psnr(a, b):
+    """PSNR in dB between two RGB565 frames, measured on their 8-bit RGB expansion."""
+    def expand(p):
+        p = p.astype(np.int32)
+        return np.stack([(p >> 11) << 3, ((p >> 5) & 0x3F) << 2, (p & 0x1F) << 3], axis=-1)
+    mse = np.mean((expand(a) - expand(b)) ** 2)
+    return float('inf') if mse == 0 else 10 * np.log10(255 ** 2 / mse)
+
+def benchmark_scale(repeats=20):
+    """Bytes, quality and upscale time of 2x/4x low-resolution frames for the bundled samples.
+
+    The upscale runs the numpy mirror of the ESP32's kernels; the ESP32's own
+    per-frame times follow if it answers BENCH_SCALE on the sensor port.
+    """
+    print(f"{'sample':<58} {'mode':>11} {'bytes':>7} {'PSNR dB':>8} {'upscale ms':>11}")
+    for name in SAMPLE_IMAGES:
+        path = os.path.join(REPO_DIR, name)
+        if not os.path.exists(path):
+            continue
+        pil_image = load_sample_image(path).convert("RGB").resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS)
+        full = to_rgb565(pil_image)
+        for factor in SCALE_FACTORS[1:]:
+            source = downscale_for_transfer(pil_image, factor)
+            for bilinear in (False, True):
+                start = time.perf_counter()
+                for _ in range(repeats):
+                    upscaled = upscale_rgb565(source, factor, bilinear=bilinear)
+                upscale_ms = (time.perf_counter() - start) * 1000 / repeats
+                mode = f"{factor}x {'bilinear' if bilinear else 'nearest'}"
+                print(f"{name:<58} {mode:>11} {source.nbytes:>7} {rgb565_psnr(full, upscaled):>8.1f} {upscale_ms:>11.2f}")
+
+    print(f"\nDevice kernels at {ESP32_IP_ADDRESS} (320x170 output, no network or SPI):")
+    reply = poll_sensor_data(command="BENCH_SCALE")
+    print(reply if reply else "ESP32 not reachable; device timings skipped.")
+
+def rgb565_per_pixel(rgb):
+    """Pixel-at-a-time packing, the way Debugging_LCD_colour/image_converter.py used to do it."""
+    out = np.empty(rgb.shape[:2], dtype=np.uint16)
+    for y in range(rgb.shape[0]):
+        for x in range(rgb.shape[1]):
+            r, g, b = rgb[y, x]
+            out[y, x] = (int(r) & 0xF8) << 8 | (int(g) & 0xFC) << 3 | int(b) >> 3
+    return out
+
+def benchmark_rgb565(repeats=20):
+    """RGB888 -> RGB565 time per frame: per-pixel Python, numpy and each native kernel.
+
+    Every path must give the same pixels; a mismatch is reported instead of a time.
+    """
+    sizes = [(160, 85), (320, 170), (640, 340), (1280, 720), (1920, 1080)]
+    paths = [("per-pixel", lambda rgb: rgb565_per_pixel(rgb)),
+             ("numpy", lambda rgb: to_rgb565_numpy(Image.fromarray(rgb, "RGB")))]
+    if rgb565_native.available():
+        print(f"Native kernels: {', '.join(rgb565_native.supported_kernels())} "
+              f"(default {rgb565_native.best_kernel()})")
+        paths += [(name, lambda rgb, name=name: rgb565_native.pack(rgb, kernel=name))
+                  for name in rgb565_native.supported_kernels()]
+    else:
+        print("Native library unavailable; numpy only.")
+
+    source = load_sample_image(os.path.join(REPO_DIR, SAMPLE_IMAGES[0])).convert("RGB")
+    print(f"{'size':>10} " + " ".join(f"{name + ' ms':>13}" for name, _ in paths) + f" {'speedup':>8}")
+    for w, h in sizes:
+        rgb = np.asarray(source.resize((w, h), Image.Resampling.BILINEAR))
+        reference = to_rgb565_numpy(Image.fromarray(rgb, "RGB"))
+        times = []
+        for name, convert in paths:
+            if name == "per-pixel" and w * h > IMAGE_WIDTH * IMAGE_HEIGHT:
+                times.append(None)  # minutes per frame; the two small sizes make the point
+                continue
+            runs = 1 if name == "per-pixel" else repeats
+            start = time.perf_counter()
+            for _ in range(runs):
+                result = convert(rgb)
+            elapsed_ms = (time.perf_counter() - start) * 1000 / runs
+            times.append(f"{elapsed_ms:.3f}" if np.array_equal(result, reference) else "MISMATCH")
+            if name == "numpy":
+                numpy_ms = elapsed_ms
+        cells = " ".join(f"{t or '-':>13}" for t in times)
+        print(f"{f'{w}x{h}':>10} {cells} {numpy_ms / elapsed_ms:>7.1f}x")
+    print("speedup: numpy time over the last (fastest) kernel in the row.")
+
+def block_error(rgb565, rgb, block=4):
+    """RMS error between block x block averages of a frame and its 8-bit source.
+
+    Roughly what the eye integrates at viewing distance: banding shows up here,
+    fine dither noise mostly averages out.
+    """
+    p = rgb565.astype(np.int32)
+    shown = np.stack([(p >> 11) << 3, ((p >> 5) & 0x3F) << 2, (p & 0x1F) << 3], axis=-1)
+    h, w = (rgb.shape[0] // block) * block, (rgb.shape[1] // block) * block
+    def means(a):
+        return a[:h, :w].reshape(h // block, block, w // block, block, 3).mean(axis=(1, 3))
+    return float(np.sqrt(np.mean((means(shown) - means(rgb.astype(np.int32))) ** 2)))
+
+def benchmark_dither(repeats=50):
+    """Time per 320x170 frame of each dither, by thread count, with its cost in RLE bytes.
+
+    "4x4 error" is the RMS error of 4x4 block averages against the source, which
+    falls when banding goes. The Python paths are the bit-exact references.
+    """
+    x = np.linspace(0, 1, IMAGE_WIDTH)[None, :, None]
+    y = np.linspace(0, 1, IMAGE_HEIGHT)[:, None, None]
+    sky = (np.array([20, 30, 90]) * (1 - x) + np.array([250, 150, 60]) * x) * (0.6 + 0.4 * y)
+    sources = [("gradient", sky.astype(np.uint8))]
+    for name in SAMPLE_IMAGES[:1]:
+        sources.append((name, np.asarray(load_sample_image(os.path.join(REPO_DIR, name))
+                                          .convert("RGB").resize((IMAGE_WIDTH, IMAGE_HEIGHT), Image.Resampling.LANCZOS))))
+    thread_counts = sorted({1, 2, 4, os.cpu_count() or 1})
+    print(f"{os.cpu_count()} CPU cores; native library {'available' if rgb565_native.available() else 'unavailable'}.")
+    print(f"{'source':<14} {'dither':<16} {'path':<11} {'ms/frame':>9} {'RLE bytes':>10} {'4x4 error':>10}")
+    for source_name, rgb in sources:
+        image = Image.fromarray(rgb, "RGB")
+        for dither in ("none", "bayer", "floyd-steinberg"):
+            reference_path = {"none": lambda: to_rgb565_numpy(image),
+                              "bayer": lambda: to_rgb565_numpy(Image.fromarray(dither_bayer(rgb), "RGB")),
+                              "floyd-steinberg": lambda: to_rgb565_numpy(Image.fromarray(dither_floyd_steinberg(rgb), "RGB"))}
+            runs = 1 if dither == "floyd-steinberg" else repeats
+            start = time.perf_counter()
+            for _ in range(runs):
+                reference = reference_path[dither]()
+            reference_ms = (time.perf_counter() - start) * 1000 / runs
+            rows = [("python" if dither == "floyd-steinberg" else "numpy", reference_ms, "")]
+            if rgb565_native.available():
+                for threads in thread_counts + [0] if dither != "none" else [1]:
+                    start = time.perf_counter()
+                    for _ in range(repeats):
+                        result = rgb565_native.pack_dithered(rgb, dither, threads=threads)
+                    elapsed_ms = (time.perf_counter() - start) * 1000 / repeats
+                    check = "" if np.array_equal(result, reference) else "  MISMATCH"
+                    rows.append((f"native x{threads}" if threads else "native auto", elapsed_ms, check))
+            size, error = len(encode_rle(reference.reshape(-1))), block_error(reference, rgb)
+            for path, ms, check in rows:
+                print(f"{source_name:<14} {dither:<16} {path:<11} {ms:>9.3f} {size:>10} {error:>10.2f}{check}")
+
+
+BENCHMARKS = {
+    "jpeg": benchmark_jpeg,
+    "palette": benchmark_palette,
+    "dither": benchmark_dither,
+    "rgb565": benchmark_rgb565,
+    "scale": benchmark_scale,
+}
+
+
+def run_polling_loop():
     print(f"*** Starting Firewall-Bypass Polling Client ***")
     print(f"Polling ESP32 at {ESP32_IP_ADDRESS} every {POLLING_INTERVAL} seconds.")
     
@@ -190,3 +1416,37 @@ if __name__ == "__main__":
         print(f"Waiting {POLLING_INTERVAL} seconds...")
 
         time.sleep(POLLING_INTERVAL)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Sensor-driven AI image client for the ESP32 display.")
+    parser.add_argument("--bench", choices=sorted(BENCHMARKS), help="run a host-side benchmark and exit")
+    parser.add_argument("--stream", type=float, nargs="?", const=STREAM_FPS, metavar="FPS",
+                        help=f"stream a pan-and-zoom animation at FPS (default {STREAM_FPS}) and exit")
+    parser.add_argument("--seconds", type=float, default=STREAM_SECONDS, help="length of the --stream animation")
+    parser.add_argument("--stream-encoding", choices=["jpeg", "delta"], default=STREAM_ENCODING)
+    parser.add_argument("--image", default=os.path.join(REPO_DIR, SAMPLE_IMAGES[0]),
+                        help="source image for --stream")
+    parser.add_argument("--badge", metavar="TEXT", help="draw TEXT as a badge in the top-right corner and exit")
+    parser.add_argument("--clock", type=float, metavar="SECONDS",
+                        help="update a clock badge in the top-right corner every second for SECONDS")
+    parser.add_argument("--cache-stats", action="store_true",
+                        help="print the ESP32's flash cache statistics (hit rate, evictions, flash throughput) and exit")
+    args = parser.parse_args()
+
+    if args.bench:
+        BENCHMARKS[args.bench]()
+    elif args.stream:
+        frames = make_animation_frames(load_sample_image(args.image), max(1, int(args.stream * args.seconds)))
+        stream_animation(encode_stream_frames(frames, args.stream_encoding), args.stream)
+        _image_session.close()
+    elif args.badge:
+        send_region(render_badge(args.badge), IMAGE_WIDTH - BADGE_SIZE[0] - 4, 4)
+        _image_session.close()
+    elif args.clock:
+        run_clock(args.clock)
+        _image_session.close()
+    elif args.cache_stats:
+        print(poll_sensor_data(command="GET_STATS"))
+    else:
+        run_polling_loop()
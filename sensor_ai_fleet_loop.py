@@ -0,0 +1,293 @@
+import argparse
+import hashlib
+import random
+import socketserver
+import struct
+import threading
+import time
+import zlib
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+from PIL import Image
+
+import sensor_ai_display_loop as display
+
+# -----------------------------------------------------------------------------
+# Fleet mode: one host drives many ESP32 displays.
+# Every cycle polls all sensor ports concurrently, generates one image per
+# distinct prompt (displays whose readings map to the same prompt share it)
+# and pushes the frames to all displays in parallel.
+# -----------------------------------------------------------------------------
+
+# --- Fleet Configuration ---
+DEVICES = [
+    {"name": "display-1", "ip": "192.168.0.17"},
+    {"name": "display-2", "ip": "192.168.0.18"},
+]
+# The temperature written into the prompt is rounded to this step, so displays
+# a fraction of a degree apart share one generated image. The scene itself is
+# still chosen from the exact reading, as in the single-display loop.
+PROMPT_TEMPERATURE_STEP = 0.5
+MAX_WORKERS = 16
+
+
+class FleetDevice:
+    """One display in the fleet, with its own keep-alive image session and delta baseline."""
+
+    def __init__(self, name, ip, image_port=display.ESP32_IMAGE_PORT, sensor_port=display.ESP32_SENSOR_PORT):
+        self.name = name
+        self.ip = ip
+        self.sensor_port = sensor_port
+        self.session = display.ImageSession(ip, image_port)
+        self.stats = {"polls": 0, "poll_failures": 0, "frames": 0, "frame_failures": 0,
+                      "poll_ms": 0.0, "send_ms": 0.0}
+
+
+def bucket_temperature(temp_value):
+    return round(temp_value / PROMPT_TEMPERATURE_STEP) * PROMPT_TEMPERATURE_STEP
+
+
+def poll_device(device):
+    start = time.perf_counter()
+    data = display.poll_sensor_data(device.ip, device.sensor_port)
+    device.stats["poll_ms"] = (time.perf_counter() - start) * 1000
+    device.stats["polls"] += 1
+    if data is None:
+        device.stats["poll_failures"] += 1
+    return data
+
+
+def push_device(device, pil_image):
+    start = time.perf_counter()
+    ok = display.send_image(pil_image, device.session)
+    device.stats["send_ms"] = (time.perf_counter() - start) * 1000
+    device.stats["frames"] += 1
+    if not ok:
+        device.stats["frame_failures"] += 1
+    return ok
+
+
+def run_fleet_cycle(devices, pool, generate):
+    """Poll, generate and push once for every device. Returns the cycle time in seconds."""
+    cycle_start = time.perf_counter()
+
+    # 1. POLL EVERY SENSOR CONCURRENTLY
+    readings = dict(zip(devices, pool.map(poll_device, devices)))
+
+    # 2. GROUP DEVICES BY PROMPT
+    groups = {}
+    for device, data in readings.items():
+        if data is None:
+            print(f"[FLEET] {device.name}: no sensor data, skipping this cycle.")
+            continue
+        temp_value = display.parse_temperature(data)
+        prompt = display.build_prompt(temp_value, shown_temp=bucket_temperature(temp_value))
+        groups.setdefault(prompt, []).append(device)
+
+    # 3. GENERATE ONE IMAGE PER DISTINCT PROMPT
+    prompts = list(groups)
+    images = dict(zip(prompts, pool.map(generate, prompts)))
+    print(f"[FLEET] {len(readings)} devices polled, {len(prompts)} distinct prompt(s) generated.")
+
+    # 4. PUSH TO ALL TARGETS IN PARALLEL
+    jobs = [(device, images[prompt]) for prompt, members in groups.items()
+            for device in members if images[prompt] is not None]
+    list(pool.map(lambda job: push_device(*job), jobs))
+
+    cycle_seconds = time.perf_counter() - cycle_start
+    print_fleet_stats(devices, cycle_seconds)
+    return cycle_seconds
+
+
+def print_fleet_stats(devices, cycle_seconds):
+    print(f"\n{'device':<14} {'address':<22} {'poll ms':>8} {'send ms':>8} {'frames':>7} {'failed':>7} {'bytes sent':>11}")
+    for d in devices:
+        address = f"{d.ip}:{d.session.port}"
+        print(f"{d.name:<14} {address:<22} {d.stats['poll_ms']:>8.1f} {d.stats['send_ms']:>8.1f} "
+              f"{d.stats['frames']:>7} {d.stats['frame_failures']:>7} {d.session.bytes_sent:>11}")
+    print(f"[FLEET] Cycle completed in {cycle_seconds:.2f} s.")
+    print("-" * 50)
+
+
+def generate_with_api(prompt):
+    return display.generate_image_from_prompt(prompt, display.STABILITY_API_KEY)
+
+
+def generate_placeholder(prompt):
+    """Deterministic stand-in for the AI API: a gradient coloured by the prompt's hash."""
+    seed = hashlib.sha256(prompt.encode('utf-8')).digest()
+    x = np.linspace(0, 1, display.IMAGE_WIDTH)[None, :, None]
+    y = np.linspace(0, 1, display.IMAGE_HEIGHT)[:, None, None]
+    start = np.array(list(seed[0:3]), dtype=float)
+    end = np.array(list(seed[3:6]), dtype=float)
+    rgb = start * (1 - x) * (1 - y / 2) + end * x * (0.5 + y / 2)
+    return Image.fromarray(rgb.clip(0, 255).astype(np.uint8), "RGB")
+
+
+# -----------------------------------------------------------------------------
+# *** LOCAL STAND-IN DEVICES ***
+# -----------------------------------------------------------------------------
+# Small Python servers that speak the ESP32's sensor (8082) and image (8080)
+# protocols, so fleet mode can run without hardware.
+
+# Same grant sizes as CREDIT_INITIAL_ROWS / CREDIT_BATCH_ROWS in the sketch.
+CREDIT_INITIAL_ROWS = 8
+CREDIT_BATCH_ROWS = 4
+
+class StandInServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def recv_exact(sock, size):
+    data = bytearray()
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            break
+        data += chunk
+    return bytes(data)
+
+
+def recv_with_credit(sock, fields):
+    """Receives the rows of a FRAME_FLAG_CREDIT frame, granting credit as drawRawRows() does."""
+    row_bytes, rows, frame_id = fields["w"] * 2, fields["h"], fields["frame_id"]
+    granted = min(CREDIT_INITIAL_ROWS, rows)
+    sock.sendall(f"CREDIT {frame_id} {granted}\n".encode('utf-8'))
+    data = bytearray()
+    for row in range(rows):
+        chunk = recv_exact(sock, row_bytes)
+        data += chunk
+        if len(chunk) < row_bytes:
+            break
+        if granted < rows and granted - (row + 1) <= CREDIT_INITIAL_ROWS - CREDIT_BATCH_ROWS:
+            grant = min(CREDIT_BATCH_ROWS, rows - granted)
+            sock.sendall(f"CREDIT {frame_id} {grant}\n".encode('utf-8'))
+            granted += grant
+    return bytes(data)
+
+
+class StandInDevice:
+    def __init__(self, name, temperature):
+        self.name = name
+        self.temperature = temperature
+        self.frames_received = 0
+        self.payload_bytes = 0
+        self.cached_keys = set()  # content keys of frames "on flash", as the sketch's frame cache
+        self.cache_hits = 0
+        self.cache_misses = 0
+        device = self
+
+        class SensorHandler(socketserver.StreamRequestHandler):
+            def handle(self):
+                if self.rfile.readline().strip() == b"GET_STATS":
+                    self.wfile.write(f"cache entries={len(device.cached_keys)} hits={device.cache_hits} "
+                                     f"misses={device.cache_misses}\r\n".encode('utf-8'))
+                    return
+                self.wfile.write(f"temp={device.temperature:.2f}C\r\n".encode('utf-8'))
+
+        class ImageHandler(socketserver.BaseRequestHandler):
+            def handle(self):
+                # A keep-alive session: frames back to back until the host closes.
+                pending = None  # (frame_id, key) of the last cache miss
+                while True:
+                    magic = recv_exact(self.request, 4)
+                    if len(magic) < 4:
+                        return
+                    if magic == display.CACHE_MAGIC:
+                        frame_id, key = struct.unpack('<IQ', recv_exact(self.request, 12))
+                        if key in device.cached_keys:
+                            device.cache_hits += 1
+                            self.request.sendall(f"HIT {frame_id}\n".encode('utf-8'))
+                        else:
+                            device.cache_misses += 1
+                            pending = (frame_id, key)
+                            self.request.sendall(f"MISS {frame_id}\n".encode('utf-8'))
+                        continue
+                    if magic == display.RESUME_MAGIC:
+                        frame_id = struct.unpack('<I', recv_exact(self.request, 4))[0]
+                        self.request.sendall(f"RESUME {frame_id} -1\n".encode('utf-8'))
+                        continue
+                    header = magic + recv_exact(self.request, display.FRAME_HEADER_SIZE - 4)
+                    try:
+                        fields = display.parse_frame_header(header)
+                    except ValueError as e:
+                        self.request.sendall(f"ERR 0 {e}\n".encode('utf-8'))
+                        return
+                    if fields["flags"] & display.FRAME_FLAG_CREDIT:
+                        payload = recv_with_credit(self.request, fields)
+                    else:
+                        payload = recv_exact(self.request, fields["payload_len"])
+                    if len(payload) < fields["payload_len"]:
+                        return
+                    if zlib.crc32(payload) & 0xFFFFFFFF != fields["crc32"]:
+                        self.request.sendall(f"ERR {fields['frame_id']} crc\n".encode('utf-8'))
+                        continue
+                    device.frames_received += 1
+                    device.payload_bytes += len(payload)
+                    self.request.sendall(f"OK {fields['frame_id']}\n".encode('utf-8'))
+                    if pending and pending[0] == fields["frame_id"]:
+                        if (fields["scale"] & 0x07) <= 1:  # low-resolution frames are not cached
+                            device.cached_keys.add(pending[1])
+                        pending = None
+
+        self.sensor_server = StandInServer(('127.0.0.1', 0), SensorHandler)
+        self.image_server = StandInServer(('127.0.0.1', 0), ImageHandler)
+        for server in (self.sensor_server, self.image_server):
+            threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    def as_fleet_device(self):
+        return FleetDevice(self.name, '127.0.0.1',
+                           image_port=self.image_server.server_address[1],
+                           sensor_port=self.sensor_server.server_address[1])
+
+    def shutdown(self):
+        for server in (self.sensor_server, self.image_server):
+            server.shutdown()
+            server.server_close()
+
+
+def run_fleet_loop(devices, generate, cycles=None, interval=display.POLLING_INTERVAL):
+    print(f"*** Starting Fleet Polling Client ({len(devices)} displays) ***")
+    with ThreadPoolExecutor(max_workers=MAX_WORKERS) as pool:
+        cycle = 0
+        while cycles is None or cycle < cycles:
+            run_fleet_cycle(devices, pool, generate)
+            cycle += 1
+            if cycles is None or cycle < cycles:
+                print(f"Waiting {interval} seconds...")
+                time.sleep(interval)
+    for device in devices:
+        device.session.close()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Drive a fleet of ESP32 displays from one host.")
+    parser.add_argument("--standin", type=int, metavar="N",
+                        help="start N local stand-in devices and drive them instead of DEVICES")
+    parser.add_argument("--cycles", type=int, help="stop after this many cycles")
+    parser.add_argument("--interval", type=float, default=display.POLLING_INTERVAL,
+                        help="seconds between cycles")
+    parser.add_argument("--placeholder-images", action="store_true",
+                        help="use generated gradients instead of calling the AI API")
+    args = parser.parse_args()
+
+    stand_ins = []
+    if args.standin:
+        # A spread of temperatures, so some stand-ins share a prompt and some do not.
+        stand_ins = [StandInDevice(f"standin-{i + 1}", random.choice([18.2, 24.1, 24.2, 31.0]))
+                     for i in range(args.standin)]
+        devices = [s.as_fleet_device() for s in stand_ins]
+    else:
+        devices = [FleetDevice(d["name"], d["ip"]) for d in DEVICES]
+
+    use_placeholder = args.placeholder_images or args.standin or not display.STABILITY_API_KEY
+    try:
+        run_fleet_loop(devices, generate_placeholder if use_placeholder else generate_with_api,
+                       cycles=args.cycles, interval=args.interval)
+    finally:
+        for s in stand_ins:
+            print(f"[STAND-IN] {s.name}: {s.frames_received} frames, {s.payload_bytes} payload bytes, "
+                  f"{s.cache_hits} cache hits, {s.cache_misses} misses.")
+            s.shutdown()
@@ -0,0 +1,75 @@
+"""send_frame_cobs() through the pseudo-terminal stand-in for the USB sketch, on a noisy line.
+
+Run from the repo root: python -m unittest discover tests
+"""
+import os
+import sys
+import unittest
+
+import numpy as np
+import serial
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "USB_Stream_GenAI_Image"))
+import gemini_image_sender_final_sanitised as sender  # noqa: E402
+
+ERROR_RATE = 1e-4  # per byte: about 11 flipped, dropped or duplicated bytes per frame
+
+
+def send(raw_data, error_rate, interlaced):
+    device = sender.CobsLoopbackDevice(error_rate)
+    ser = serial.Serial(device.port, sender.BAUD_RATE)
+    try:
+        ok, stats = sender.send_frame_cobs(ser, raw_data, interlaced=interlaced)
+    finally:
+        ser.close()
+        os.close(device.master)
+        os.close(device.slave)
+    return device, ok, stats
+
+
+class CobsLoopbackTest(unittest.TestCase):
+    def setUp(self):
+        self.reply_timeout = sender.COBS_REPLY_TIMEOUT
+        sender.COBS_REPLY_TIMEOUT = 0.3  # a pty answers in microseconds
+        pixels = sender.IMAGE_WIDTH * sender.IMAGE_HEIGHT
+        self.raw_data = np.random.default_rng(1).integers(0, 65536, pixels, dtype=np.uint16).astype('<u2').tobytes()
+
+    def tearDown(self):
+        sender.COBS_REPLY_TIMEOUT = self.reply_timeout
+
+    def test_clean_line(self):
+        device, ok, stats = send(self.raw_data, 0, interlaced=False)
+        self.assertTrue(ok)
+        self.assertEqual(device.image(), self.raw_data)
+        self.assertEqual((stats["rounds"], stats["rows_resent"], stats["nacks"]), (1, 0, 0))
+
+    def test_noisy_line(self):
+        _, _, clean = send(self.raw_data, 0, interlaced=False)
+        for interlaced in (False, True):
+            with self.subTest(interlaced=interlaced):
+                device, ok, stats = send(self.raw_data, ERROR_RATE, interlaced)
+                self.assertGreater(device.injected, 0)
+                self.assertTrue(ok)
+                self.assertEqual(device.image(), self.raw_data)
+                # A damaged byte costs at most the two packets it can merge, resent in later rounds.
+                self.assertLessEqual(stats["rows_resent"], 2 * device.injected)
+                self.assertLessEqual(stats["rounds"], 4)
+                row_packet = len(sender.cobs_packet(bytes(2 + sender.IMAGE_WIDTH * 2)))
+                self.assertLessEqual(stats["wire_bytes"] - clean["wire_bytes"],
+                                     stats["rows_resent"] * (row_packet + 2) + stats["rounds"] * 8)
+
+    def test_interlaced_preview_covers_every_row(self):
+        device, ok, stats = send(self.raw_data, 0, interlaced=True)
+        self.assertTrue(ok)
+        self.assertIsNotNone(stats["preview_ms"])
+        row_bytes = sender.IMAGE_WIDTH * 2
+        # After pass 1 each row shows the pass-1 row above it, copied down as the sketch does.
+        for r, row in enumerate(device.preview):
+            source = r - r % 8
+            self.assertEqual(row, self.raw_data[source * row_bytes:(source + 1) * row_bytes], f"row {r}")
+        self.assertLess(device.preview_bytes, device.received_bytes * 0.15)
+        self.assertEqual(device.image(), self.raw_data)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,58 @@
+"""One fleet cycle against local stand-in devices: prompt sharing, delivery and the frame cache.
+
+Run from the repo root: python -m unittest discover tests
+"""
+import contextlib
+import io
+import os
+import sys
+import threading
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import sensor_ai_fleet_loop as fleet  # noqa: E402
+
+
+class FleetCycleTest(unittest.TestCase):
+    def setUp(self):
+        # 24.1 and 24.2 round to the same prompt; 31.0 gets one of its own.
+        self.stand_ins = [fleet.StandInDevice(f"standin-{i + 1}", t) for i, t in enumerate((24.1, 24.2, 31.0))]
+        self.devices = [s.as_fleet_device() for s in self.stand_ins]
+        self.prompts = []
+        self.lock = threading.Lock()
+
+    def tearDown(self):
+        for device in self.devices:
+            device.session.close()
+        for stand_in in self.stand_ins:
+            stand_in.shutdown()
+
+    def generate(self, prompt):
+        with self.lock:
+            self.prompts.append(prompt)
+        return fleet.generate_placeholder(prompt)
+
+    def run_cycle(self, pool):
+        with contextlib.redirect_stdout(io.StringIO()):
+            fleet.run_fleet_cycle(self.devices, pool, self.generate)
+
+    def test_shared_prompt_delivery_and_cache(self):
+        with ThreadPoolExecutor(max_workers=fleet.MAX_WORKERS) as pool:
+            self.run_cycle(pool)
+            self.assertEqual(len(self.prompts), 2)
+            self.assertEqual(len(set(self.prompts)), 2)
+            for stand_in, device in zip(self.stand_ins, self.devices):
+                self.assertEqual(stand_in.frames_received, 1, stand_in.name)
+                self.assertEqual(device.stats["frame_failures"], 0, stand_in.name)
+                self.assertEqual(stand_in.cache_misses, 1, stand_in.name)
+
+            # Same readings, same images: every display already has its frame cached.
+            self.run_cycle(pool)
+            for stand_in in self.stand_ins:
+                self.assertEqual(stand_in.frames_received, 1, stand_in.name)
+                self.assertEqual(stand_in.cache_hits, 1, stand_in.name)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,88 @@
+"""Round trip of encode_frame() through parse_frame_header(), and the headers the ESP32 must refuse.
+
+Run from the repo root: python -m unittest discover tests
+"""
+import os
+import struct
+import sys
+import unittest
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import sensor_ai_display_loop as host  # noqa: E402
+
+
+def header(payload_len, **fields):
+    """A raw header with every field valid, except those overridden in `fields`."""
+    values = dict(magic=host.FRAME_MAGIC, version=host.FRAME_PROTOCOL_VERSION, pixel_format=host.PIXFMT_RGB565,
+                  encoding=host.ENC_RAW, scale=0, flags=0, reserved1=0, x=0, y=0,
+                  w=host.IMAGE_WIDTH, h=host.IMAGE_HEIGHT, payload_len=payload_len, frame_id=7, crc32=0)
+    values.update(fields)
+    return struct.pack(host.FRAME_HEADER_FORMAT, *values.values())
+
+
+class RoundTripTest(unittest.TestCase):
+    def test_full_raw_frame(self):
+        payload = bytes(range(256)) * (host.EXPECTED_SIZE // 256) + bytes(host.EXPECTED_SIZE % 256)
+        frame = host.encode_frame(payload, frame_id=42)
+        self.assertEqual(len(frame), host.FRAME_HEADER_SIZE + len(payload))
+        fields = host.parse_frame_header(frame)
+        self.assertEqual(fields["frame_id"], 42)
+        self.assertEqual((fields["x"], fields["y"], fields["w"], fields["h"]),
+                         (0, 0, host.IMAGE_WIDTH, host.IMAGE_HEIGHT))
+        self.assertEqual(fields["payload_len"], len(payload))
+        self.assertEqual(fields["crc32"], zlib.crc32(payload))
+        self.assertEqual(frame[host.FRAME_HEADER_SIZE:], payload)
+
+    def test_region(self):
+        payload = bytes(2 * 40 * 20)
+        fields = host.parse_frame_header(host.encode_frame(payload, x=280, y=150, w=40, h=20, frame_id=3))
+        self.assertEqual((fields["x"], fields["y"], fields["w"], fields["h"]), (280, 150, 40, 20))
+
+    def test_rle(self):
+        payload = host.encode_rle(host.np.zeros(host.IMAGE_WIDTH * host.IMAGE_HEIGHT, dtype=host.np.uint16))
+        fields = host.parse_frame_header(host.encode_frame(payload, encoding=host.ENC_RLE, frame_id=5))
+        self.assertEqual(fields["encoding"], host.ENC_RLE)
+        self.assertEqual(fields["payload_len"], len(payload))
+
+
+class RejectTest(unittest.TestCase):
+    def assertRejected(self, reason, data):
+        with self.assertRaises(ValueError) as raised:
+            host.parse_frame_header(data)
+        self.assertEqual(str(raised.exception), reason)
+
+    def test_valid_baseline(self):
+        host.parse_frame_header(header(host.EXPECTED_SIZE))
+
+    def test_short(self):
+        self.assertRejected("short", header(host.EXPECTED_SIZE)[:host.FRAME_HEADER_SIZE - 1])
+
+    def test_magic(self):
+        self.assertRejected("magic", header(host.EXPECTED_SIZE, magic=b'IMGX'))
+
+    def test_version(self):
+        self.assertRejected("version", header(host.EXPECTED_SIZE, version=host.FRAME_PROTOCOL_VERSION + 1))
+
+    def test_reserved(self):
+        self.assertRejected("reserved", header(host.EXPECTED_SIZE, reserved1=1))
+        self.assertRejected("reserved", header(host.EXPECTED_SIZE, flags=0x8000))
+
+    def test_empty(self):
+        self.assertRejected("empty", header(0, w=0))
+        self.assertRejected("empty", header(0, h=0))
+
+    def test_geometry(self):
+        self.assertRejected("geometry", header(2 * 10 * 10, x=host.IMAGE_WIDTH - 9, w=10, h=10))
+        self.assertRejected("geometry", header(2 * 10 * 10, y=host.IMAGE_HEIGHT - 9, w=10, h=10))
+        self.assertRejected("geometry", header(2 * host.IMAGE_WIDTH * host.IMAGE_HEIGHT, w=host.IMAGE_WIDTH + 1))
+
+    def test_length(self):
+        self.assertRejected("length", header(host.EXPECTED_SIZE - 2))
+        self.assertRejected("length", header(host.EXPECTED_SIZE + 2))
+        self.assertRejected("length", header(0, encoding=host.ENC_RLE))
+        self.assertRejected("length", header(host.MAX_JPEG_BYTES + 1, encoding=host.ENC_JPEG))
+
+
+if __name__ == "__main__":
+    unittest.main()